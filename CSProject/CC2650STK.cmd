@@ -47,7 +47,13 @@
 /* The starting address of the application.  Normally the interrupt vectors  */
 /* must be located at the beginning of the application.                      */
 #define FLASH_BASE              0x0
-#define FLASH_SIZE              0x20000
+#define FLASH_SIZE              0x1D000
+/* Sectors reserved for storage/flash_store.c records                       */
+#define FLASH_STORE_BASE        0x1D000
+#define FLASH_STORE_SIZE        0x2000
+/* Last sector, CCFG sits at its top                                         */
+#define FLASH_CCFG_BASE         0x1F000
+#define FLASH_CCFG_SIZE         0x1000
 #define RAM_BASE                0x20000000
 #define RAM_SIZE                0x5000
 
@@ -57,6 +63,10 @@ MEMORY
 {
     /* Application stored in and executes from internal flash */
     FLASH (RX) : origin = FLASH_BASE, length = FLASH_SIZE
+    /* Persistent records, kept out of the application image */
+    FLASH_STORE (R) : origin = FLASH_STORE_BASE, length = FLASH_STORE_SIZE
+    /* Customer configuration area */
+    FLASH_CCFG (RX) : origin = FLASH_CCFG_BASE, length = FLASH_CCFG_SIZE
     /* Application uses internal RAM for data */
     SRAM (RWX) : origin = RAM_BASE, length = RAM_SIZE
 }
@@ -73,7 +83,7 @@ SECTIONS
     .pinit          :   > FLASH
     .init_array     :   > FLASH
     .emb_text       :   > FLASH
-    .ccfg           :   > FLASH (HIGH)
+    .ccfg           :   > FLASH_CCFG (HIGH)
 
 #ifdef __TI_COMPILER_VERSION__
 #if __TI_COMPILER_VERSION__ >= 15009000
@@ -0,0 +1,326 @@
+/*
+ * morse.c
+ *
+ *  Morse table and binary-tree decoder, see morse.h
+ */
+
+#include <string.h>
+
+#include "morse/morse.h"
+
+// Node index past the tree: a letter with too many elements
+#define MORSE_NODE_INVALID  0
+
+// Packed code from its elements, dispatched on the number of arguments
+#define DIT  0
+#define DAH  1
+#define CODE(...)  CODE_N(__VA_ARGS__, CODE9, CODE8, CODE7, CODE6, CODE5, CODE4, CODE3, CODE2, CODE1, 0)(__VA_ARGS__)
+#define CODE_N(e1, e2, e3, e4, e5, e6, e7, e8, e9, n, ...)  n
+#define CODE1(a)                          (0x02 | (a))
+#define CODE2(a, b)                       (CODE1(a) << 1 | (b))
+#define CODE3(a, b, c)                    (CODE2(a, b) << 1 | (c))
+#define CODE4(a, b, c, d)                 (CODE3(a, b, c) << 1 | (d))
+#define CODE5(a, b, c, d, e)              (CODE4(a, b, c, d) << 1 | (e))
+#define CODE6(a, b, c, d, e, f)           (CODE5(a, b, c, d, e) << 1 | (f))
+#define CODE7(a, b, c, d, e, f, g)        (CODE6(a, b, c, d, e, f) << 1 | (g))
+#define CODE8(a, b, c, d, e, f, g, h)     (CODE7(a, b, c, d, e, f, g) << 1 | (h))
+#define CODE9(a, b, c, d, e, f, g, h, i)  (CODE8(a, b, c, d, e, f, g, h) << 1 | (i))
+
+// The Morse table (ITU-R M.1677-1 plus the common ! ; _ $), the encoder and decoder tables
+// below are generated from it
+#define MORSE_TABLE(X) \
+    X('A', CODE(DIT, DAH))                X('B', CODE(DAH, DIT, DIT, DIT)) \
+    X('C', CODE(DAH, DIT, DAH, DIT))      X('D', CODE(DAH, DIT, DIT)) \
+    X('E', CODE(DIT))                     X('F', CODE(DIT, DIT, DAH, DIT)) \
+    X('G', CODE(DAH, DAH, DIT))           X('H', CODE(DIT, DIT, DIT, DIT)) \
+    X('I', CODE(DIT, DIT))                X('J', CODE(DIT, DAH, DAH, DAH)) \
+    X('K', CODE(DAH, DIT, DAH))           X('L', CODE(DIT, DAH, DIT, DIT)) \
+    X('M', CODE(DAH, DAH))                X('N', CODE(DAH, DIT)) \
+    X('O', CODE(DAH, DAH, DAH))           X('P', CODE(DIT, DAH, DAH, DIT)) \
+    X('Q', CODE(DAH, DAH, DIT, DAH))      X('R', CODE(DIT, DAH, DIT)) \
+    X('S', CODE(DIT, DIT, DIT))           X('T', CODE(DAH)) \
+    X('U', CODE(DIT, DIT, DAH))           X('V', CODE(DIT, DIT, DIT, DAH)) \
+    X('W', CODE(DIT, DAH, DAH))           X('X', CODE(DAH, DIT, DIT, DAH)) \
+    X('Y', CODE(DAH, DIT, DAH, DAH))      X('Z', CODE(DAH, DAH, DIT, DIT)) \
+    X('1', CODE(DIT, DAH, DAH, DAH, DAH)) X('2', CODE(DIT, DIT, DAH, DAH, DAH)) \
+    X('3', CODE(DIT, DIT, DIT, DAH, DAH)) X('4', CODE(DIT, DIT, DIT, DIT, DAH)) \
+    X('5', CODE(DIT, DIT, DIT, DIT, DIT)) X('6', CODE(DAH, DIT, DIT, DIT, DIT)) \
+    X('7', CODE(DAH, DAH, DIT, DIT, DIT)) X('8', CODE(DAH, DAH, DAH, DIT, DIT)) \
+    X('9', CODE(DAH, DAH, DAH, DAH, DIT)) X('0', CODE(DAH, DAH, DAH, DAH, DAH)) \
+    X('.', CODE(DIT, DAH, DIT, DAH, DIT, DAH))  X(',', CODE(DAH, DAH, DIT, DIT, DAH, DAH)) \
+    X(':', CODE(DAH, DAH, DAH, DIT, DIT, DIT))  X('?', CODE(DIT, DIT, DAH, DAH, DIT, DIT)) \
+    X('\'', CODE(DIT, DAH, DAH, DAH, DAH, DIT)) X('-', CODE(DAH, DIT, DIT, DIT, DIT, DAH)) \
+    X('/', CODE(DAH, DIT, DIT, DAH, DIT))       X('(', CODE(DAH, DIT, DAH, DAH, DIT)) \
+    X(')', CODE(DAH, DIT, DAH, DAH, DIT, DAH))  X('"', CODE(DIT, DAH, DIT, DIT, DAH, DIT)) \
+    X('=', CODE(DAH, DIT, DIT, DIT, DAH))       X('+', CODE(DIT, DAH, DIT, DAH, DIT)) \
+    X('@', CODE(DIT, DAH, DAH, DIT, DAH, DIT))  X('!', CODE(DAH, DIT, DAH, DIT, DAH, DAH)) \
+    X(';', CODE(DAH, DIT, DAH, DIT, DAH, DIT))  X('_', CODE(DIT, DIT, DAH, DAH, DIT, DAH)) \
+    X('$', CODE(DIT, DIT, DIT, DAH, DIT, DIT, DAH))
+
+// Accented letters (spelled in UTF-8) and prosigns, decoded to MORSE_EXTENDED + index
+#define MORSE_EXTENDED_TABLE(X) \
+    X(0, "\xC3\x84", CODE(DIT, DAH, DIT, DAH))                          /* A umlaut */ \
+    X(1, "\xC3\x85", CODE(DIT, DAH, DAH, DIT, DAH))                     /* A ring, also A grave */ \
+    X(2, "\xC3\x89", CODE(DIT, DIT, DAH, DIT, DIT))                     /* E acute */ \
+    X(3, "\xC3\x88", CODE(DIT, DAH, DIT, DIT, DAH))                     /* E grave */ \
+    X(4, "\xC3\x91", CODE(DAH, DAH, DIT, DAH, DAH))                     /* N tilde */ \
+    X(5, "\xC3\x96", CODE(DAH, DAH, DAH, DIT))                          /* O umlaut */ \
+    X(6, "\xC3\x9C", CODE(DIT, DIT, DAH, DAH))                          /* U umlaut */ \
+    X(7, "\xC3\x87", CODE(DAH, DIT, DAH, DIT, DIT))                     /* C cedilla */ \
+    X(8, "<SK>", CODE(DIT, DIT, DIT, DAH, DIT, DAH))                    /* End of work */ \
+    X(9, "<SN>", CODE(DIT, DIT, DIT, DAH, DIT))                         /* Understood */ \
+    X(10, "<CT>", CODE(DAH, DIT, DAH, DIT, DAH))                        /* Starting signal */ \
+    X(11, "<AS>", CODE(DIT, DAH, DIT, DIT, DIT))                        /* Wait */ \
+    X(12, "<HH>", CODE(DIT, DIT, DIT, DIT, DIT, DIT, DIT, DIT))         /* Error */ \
+    X(13, "<SOS>", CODE(DIT, DIT, DIT, DAH, DAH, DAH, DIT, DIT, DIT))   /* Distress */
+
+// Other spellings the encoder accepts: prosigns that share a code with punctuation, lower case
+#define MORSE_ALIASES(X) \
+    X("<AR>", '+') X("<BT>", '=') X("<KN>", '(') X("\xC3\x80", MORSE_EXTENDED + 1) \
+    X("\xC3\xA4", MORSE_EXTENDED + 0) X("\xC3\xA5", MORSE_EXTENDED + 1) X("\xC3\xA0", MORSE_EXTENDED + 1) \
+    X("\xC3\xA9", MORSE_EXTENDED + 2) X("\xC3\xA8", MORSE_EXTENDED + 3) X("\xC3\xB1", MORSE_EXTENDED + 4) \
+    X("\xC3\xB6", MORSE_EXTENDED + 5) X("\xC3\xBC", MORSE_EXTENDED + 6) X("\xC3\xA7", MORSE_EXTENDED + 7)
+
+#define TREE_ENTRY(c, code)                [code] = c,
+#define ENCODE_ENTRY(c, code)              [(unsigned char)(c)] = code,
+#define EXTENDED_TREE_ENTRY(i, name, code)    [code] = (char)(MORSE_EXTENDED + (i)),
+#define EXTENDED_ENCODE_ENTRY(i, name, code)  [MORSE_EXTENDED + (i)] = code,
+#define NAME_ENTRY(i, name, code)          [i] = name,
+#define ALIAS_ENTRY(name, c)               { name, (char)(c) },
+
+// Character at each tree node, 0 where no code ends
+static const char morseTree[MORSE_TREE_SIZE] = {
+    MORSE_TABLE(TREE_ENTRY)
+    MORSE_EXTENDED_TABLE(EXTENDED_TREE_ENTRY)
+};
+
+// Packed code of each character byte, 0 where there is none
+static const uint16_t morseCodes[256] = {
+    MORSE_TABLE(ENCODE_ENTRY)
+    MORSE_EXTENDED_TABLE(EXTENDED_ENCODE_ENTRY)
+};
+
+// Spelling of the extended characters
+static const char *const morseNames[] = { MORSE_EXTENDED_TABLE(NAME_ENTRY) };
+#define MORSE_NAMES  (sizeof(morseNames) / sizeof(morseNames[0]))
+
+static const struct {
+    const char *name;
+    char c;
+} morseAliases[] = { MORSE_ALIASES(ALIAS_ENTRY) };
+#define MORSE_ALIAS_COUNT  (sizeof(morseAliases) / sizeof(morseAliases[0]))
+
+// Follow one element down the tree
+static uint16_t step(uint16_t node, char element) {
+
+    if (node == MORSE_NODE_INVALID || node >= MORSE_TREE_SIZE / 2 || (element != '.' && element != '-')) {
+        return MORSE_NODE_INVALID;
+    }
+    return (node << 1) | (element == '-');
+}
+
+void morse_decoder_init(morse_decoder_t *d) {
+
+    d->node = 1;
+    d->spaces = 2;
+}
+
+char morse_decoder_feed(morse_decoder_t *d, char symbol) {
+
+    if (symbol == '.' || symbol == '-') {
+        d->node = step(d->node, symbol);
+        d->spaces = 0;
+        return 0;
+    }
+    if (symbol != ' ') {
+        return 0;
+    }
+
+    // First space ends the letter, the second the word, more are ignored
+    d->spaces++;
+    if (d->spaces == 1) {
+        char c = morse_decode(d->node);
+        d->node = 1;
+        return c;
+    }
+    return d->spaces == 2 ? ' ' : 0;
+}
+
+char morse_lookup(const char *morse) {
+
+    uint16_t node = 1;
+
+    while (*morse) {
+        node = step(node, *morse++);
+    }
+    return morse_decode(node);
+}
+
+uint16_t morse_encode(char c) {
+
+    if (c >= 'a' && c <= 'z') {
+        c -= 'a' - 'A';
+    }
+    return morseCodes[(unsigned char)c];
+}
+
+char morse_decode(uint16_t code) {
+
+    char c = code < MORSE_TREE_SIZE ? morseTree[code] : 0;
+    return c ? c : MORSE_UNKNOWN;
+}
+
+int morse_spell(char c, char *out) {
+
+    uint8_t i = (unsigned char)c - MORSE_EXTENDED;
+    int n;
+
+    if ((unsigned char)c < MORSE_EXTENDED || i >= MORSE_NAMES) {
+        out[0] = c;
+        return 1;
+    }
+    for (n = 0; morseNames[i][n] != '\0'; n++) {
+        out[n] = morseNames[i][n];
+    }
+    return n;
+}
+
+// Character spelled by the text at c, or c itself. Prosigns and UTF-8 letters
+// take more than one byte, *length is set to the bytes used. A UTF-8 sequence
+// without a Morse code returns 0 and is skipped whole, so its bytes never alias
+// the extended codes
+static char readSpelling(const char *text, uint32_t available, uint8_t *length) {
+
+    uint8_t i;
+
+    *length = 1;
+    if (text[0] != '<' && (unsigned char)text[0] < 0x80) {
+        return text[0];
+    }
+    for (i = 0; i < MORSE_NAMES; i++) {
+        uint8_t n = strlen(morseNames[i]);
+        if (n <= available && strncmp(text, morseNames[i], n) == 0) {
+            *length = n;
+            return (char)(MORSE_EXTENDED + i);
+        }
+    }
+    for (i = 0; i < MORSE_ALIAS_COUNT; i++) {
+        uint8_t n = strlen(morseAliases[i].name);
+        if (n <= available && strncmp(text, morseAliases[i].name, n) == 0) {
+            *length = n;
+            return morseAliases[i].c;
+        }
+    }
+    if ((unsigned char)text[0] >= 0x80) {
+        while (*length < available && ((unsigned char)text[*length] & 0xC0) == 0x80) {
+            (*length)++;
+        }
+        return 0;
+    }
+    return text[0];
+}
+
+void morse_encoder_init(morse_encoder_t *e) {
+
+    e->text = 0;
+    e->length = 0;
+    e->code = 0;
+    e->element = -1;
+    e->gap = 0;
+}
+
+void morse_encoder_input(morse_encoder_t *e, const char *text, uint32_t length) {
+
+    e->text = text;
+    e->length = length;
+}
+
+int morse_encoder_next(morse_encoder_t *e, morse_event_t *event) {
+
+    while (e->element < 0) {
+        uint8_t used;
+        char c;
+        if (e->length == 0) {
+            return 0;
+        }
+        c = readSpelling(e->text, e->length, &used);
+        e->text += used;
+        e->length -= used;
+
+        // A word gap only follows a letter, leading and repeated whitespace adds nothing
+        if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+            if (e->gap > 0) {
+                e->gap = 7;
+            }
+            continue;
+        }
+        e->code = morse_encode(c);
+        if (e->code > 1) {
+            e->element = 0;
+            while ((e->code >> (e->element + 1)) > 1) {
+                e->element++;
+            }
+        }
+    }
+
+    if (e->gap > 0) {
+        event->on = 0;
+        event->units = e->gap;
+        e->gap = 0;
+        return 1;
+    }
+    event->on = 1;
+    event->units = (e->code >> e->element) & 1 ? 3 : 1;
+    e->element--;
+    e->gap = e->element < 0 ? 3 : 1;
+    return 1;
+}
+
+int morse_encoder_end(morse_encoder_t *e, morse_event_t *event) {
+
+    if (e->gap == 0 || e->element >= 0) {
+        return 0;
+    }
+    event->on = 0;
+    event->units = e->gap;
+    e->gap = 0;
+    return 1;
+}
+
+int morse_encode_events(morse_encoder_t *e, morse_event_t *out, int size) {
+
+    int n = 0;
+
+    while (n < size && morse_encoder_next(e, &out[n])) {
+        n++;
+    }
+    return n;
+}
+
+int morse_encode_symbols(morse_encoder_t *e, char *out, int size) {
+
+    morse_event_t event;
+    int n = 0;
+
+    // A word gap takes two symbols, stop while there is still room for it
+    while (n < size - 1 && morse_encoder_next(e, &event)) {
+        if (event.on) {
+            out[n++] = event.units == 1 ? '.' : '-';
+
+            // The element gaps inside a letter have no symbol, write the rest of it at once
+            if (n + e->element + 1 < size) {
+                while (e->element >= 0) {
+                    out[n++] = (e->code >> e->element--) & 1 ? '-' : '.';
+                }
+                e->gap = 3;
+            }
+        }
+        else if (event.units >= 3) {
+            out[n++] = ' ';
+            if (event.units == 7) {
+                out[n++] = ' ';
+            }
+        }
+    }
+    return n;
+}
@@ -0,0 +1,97 @@
+/*
+ * morse.h
+ *
+ *  Morse code table and decoder shared by the firmware and the host tools
+ *  (morse_decoder.c), so both turn the same symbol stream into the same text.
+ *  Plain C, no TI headers.
+ *
+ *  Input symbols are '.', '-' and ' ': one space ends a letter, a second
+ *  space ends a word.
+ *
+ *  A code is packed into one integer: a leading 1 bit, then one bit per
+ *  element, dot 0 and dash 1, so ".-" is 0b101. Decoding walks a binary tree
+ *  stored as an array in the same numbering, root at index 1, a dot goes to
+ *  2i and a dash to 2i + 1, so the node reached is the packed code and a
+ *  letter is a single table load. Both directions are generated at compile
+ *  time from the one table in morse.c.
+ *
+ *  The encoder turns text into timed key events in dot units (dot 1, dash 3,
+ *  gaps 1 between elements, 3 between letters, 7 between words) or into the
+ *  same symbols the decoder reads. It pulls one event at a time and writes
+ *  only into buffers the caller passes, so the tag can key text out directly
+ *  and the host tool can encode input of any size.
+ */
+
+#ifndef MORSE_H_
+#define MORSE_H_
+
+#include <stdint.h>
+
+#define MORSE_MAX_ELEMENTS  9                           // <SOS> is ...---...
+#define MORSE_TREE_SIZE     (2 << MORSE_MAX_ELEMENTS)   // Index of the longest code + 1
+#define MORSE_UNKNOWN       '?'
+
+// Accented letters and prosigns decode to bytes from MORSE_EXTENDED up, morse_spell()
+// gives their text: the letter in UTF-8 or the prosign in angle brackets like "<SK>"
+#define MORSE_EXTENDED      0x80
+#define MORSE_SPELL_MAX     5                           // "<SOS>"
+
+typedef struct {
+    uint16_t node;     // Tree index of the elements so far, 1 = none
+    uint8_t spaces;    // Spaces since the last element
+} morse_decoder_t;
+
+void morse_decoder_init(morse_decoder_t *d);
+
+// Feed one symbol. Returns the decoded character when a letter ends, ' '
+// when a word ends and 0 otherwise. Codes not in the table decode to '?'
+char morse_decoder_feed(morse_decoder_t *d, char symbol);
+
+// True while elements of an unfinished letter are buffered
+#define morse_decoder_pending(d)  ((d)->node != 1)
+
+typedef struct {
+    uint8_t on;        // 1 key down, 0 silence
+    uint8_t units;     // Length in dot units
+} morse_event_t;
+
+typedef struct {
+    const char *text;  // Unread input
+    uint32_t length;
+    uint16_t code;     // Packed code of the letter being keyed
+    int8_t element;    // Bit of the next element in code, -1 between letters
+    uint8_t gap;       // Silence owed before the next key down, in units
+} morse_encoder_t;
+
+void morse_encoder_init(morse_encoder_t *e);
+
+// Hand the encoder more text, the gap state carries over from the previous input.
+// Characters without a code are skipped, any whitespace is a word gap. Prosigns
+// are written in angle brackets ("<SK>"), accented letters in UTF-8; a spelling
+// split between two inputs is not recognized
+void morse_encoder_input(morse_encoder_t *e, const char *text, uint32_t length);
+
+// Next event, 0 when the input is used up. The gap after the last letter is
+// held back until more text arrives or morse_encoder_end() takes it
+int morse_encoder_next(morse_encoder_t *e, morse_event_t *event);
+int morse_encoder_end(morse_encoder_t *e, morse_event_t *event);
+
+// Fill out with events or with '.', '-', ' ' symbols (no terminator) until it is
+// full or the input is used up, returns the number written. Call again to resume
+int morse_encode_events(morse_encoder_t *e, morse_event_t *out, int size);
+int morse_encode_symbols(morse_encoder_t *e, char *out, int size);
+
+// Decode one letter such as ".-", '?' when unknown
+char morse_lookup(const char *morse);
+
+// Packed code of a character, either case, 0 when it has none
+uint16_t morse_encode(char c);
+
+// Character of a packed code, '?' when unknown
+char morse_decode(uint16_t code);
+
+// Text of a decoded character into out (MORSE_SPELL_MAX bytes, no terminator),
+// returns its length. Plain characters are copied as they are
+int morse_spell(char c, char *out);
+
+#endif /* MORSE_H_ */
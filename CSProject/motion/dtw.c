@@ -0,0 +1,200 @@
+/*
+ * dtw.c
+ *
+ *  Subsequence DTW gesture recognizer (SPRING), see dtw.h
+ */
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "motion/dtw.h"
+#include "motion/fixmath.h"
+
+#define DTW_INF  0xFFFFFFFFUL
+
+static void resetMatcher(dtw_matcher_t *m) {
+
+    uint8_t i;
+
+    for (i = 0; i < DTW_MAX_LEN; i++) {
+        m->cost[i] = DTW_INF;
+        m->start[i] = 0;
+    }
+    m->best = DTW_INF;
+}
+
+void dtw_init(dtw_t *d, uint16_t rate_hz) {
+
+    uint8_t t;
+
+    memset(d, 0, sizeof(*d));
+    for (t = 0; t < DTW_MAX_TEMPLATES; t++) {
+        resetMatcher(&d->matchers[t]);
+    }
+    d->recordSlot = -1;
+    dtw_set_rate(d, rate_hz);
+}
+
+void dtw_set_rate(dtw_t *d, uint16_t rate_hz) {
+
+    d->decimation = rate_hz > DTW_FRAME_HZ ? rate_hz / DTW_FRAME_HZ : 1;
+    d->count = 0;
+    memset(d->sum, 0, sizeof(d->sum));
+}
+
+int dtw_record(dtw_t *d, uint8_t slot, char symbol) {
+
+    if (slot >= DTW_MAX_TEMPLATES) {
+        return -1;
+    }
+    d->templates[slot].length = 0;
+    d->templates[slot].symbol = symbol;
+    d->recordSlot = slot;
+    d->recordQuiet = 0;
+    resetMatcher(&d->matchers[slot]);
+    return 0;
+}
+
+static uint32_t distance(const int16_t *a, const int16_t *b) {
+
+    uint32_t sum = 0;
+    uint8_t f;
+
+    for (f = 0; f < DTW_FEATURES; f++) {
+        int32_t diff = a[f] - b[f];
+        sum += diff < 0 ? -diff : diff;
+    }
+    return sum;
+}
+
+// Append a frame to the template being recorded, motion energy trims idle frames at both ends
+static void recordFrame(dtw_t *d, const int16_t *frame) {
+
+    dtw_template_t *tpl = &d->templates[d->recordSlot];
+    static const int16_t still[DTW_FEATURES] = { 0 };
+    uint32_t energy = distance(frame, still);
+
+    if (tpl->length == 0 && energy < DTW_RECORD_ENERGY) {
+        return;
+    }
+    memcpy(tpl->frame[tpl->length++], frame, sizeof(tpl->frame[0]));
+    d->recordQuiet = energy < DTW_RECORD_ENERGY ? d->recordQuiet + 1 : 0;
+
+    // Three still frames or a full slot end the recording
+    if (d->recordQuiet >= 3 || tpl->length == DTW_MAX_LEN) {
+        tpl->length -= d->recordQuiet;
+        if (tpl->length < DTW_MIN_LEN) {
+            tpl->length = 0;
+        }
+        tpl->threshold = (uint32_t)tpl->length * DTW_FRAME_THRESHOLD;
+        d->recordSlot = -1;
+    }
+}
+
+// One SPRING step, returns true when the best match so far is final
+static bool matchFrame(const dtw_template_t *tpl, dtw_matcher_t *m, const int16_t *frame, uint32_t t) {
+
+    uint32_t diag = 0, diagStart = t;   // D(t-1, 0) = 0, a path may start at any frame
+    uint32_t left = 0, leftStart = t;   // D(t, 0) = 0
+    bool done;
+    uint8_t i;
+
+    for (i = 0; i < tpl->length; i++) {
+        uint32_t up = m->cost[i], upStart = m->start[i];
+        uint32_t best = left, bestStart = leftStart;
+
+        if (up < best) {
+            best = up;
+            bestStart = upStart;
+        }
+        if (diag < best || (diag == best && diagStart > bestStart)) {
+            best = diag;
+            bestStart = diagStart;
+        }
+        diag = up;
+        diagStart = upStart;
+
+        left = best == DTW_INF ? DTW_INF : best + distance(frame, tpl->frame[i]);
+        leftStart = bestStart;
+        m->cost[i] = left;
+        m->start[i] = leftStart;
+    }
+
+    // Report the candidate once no open path can still improve on it, or once
+    // it has not improved for DTW_SETTLE_FRAMES (slow paths through repeated
+    // near-still template frames would otherwise hold it back)
+    done = false;
+    if (m->best != DTW_INF) {
+        done = true;
+        if (t - m->bestEnd >= DTW_SETTLE_FRAMES) {
+            return true;
+        }
+        for (i = 0; i < tpl->length; i++) {
+            if (m->cost[i] < m->best && m->start[i] <= m->bestEnd) {
+                done = false;
+                break;
+            }
+        }
+    }
+    if (!done && left <= tpl->threshold && left < m->best) {
+        m->best = left;
+        m->bestStart = leftStart;
+        m->bestEnd = t;
+    }
+    return done;
+}
+
+char dtw_update(dtw_t *d, const int32_t accel[3], const int32_t gyro[3]) {
+
+    int32_t ax = accel[0] >> 6, ay = accel[1] >> 6, az = accel[2] >> 6;  // Q10 g
+    int32_t norm = fix_sqrt((uint32_t)(ax * ax) + (uint32_t)(ay * ay) + (uint32_t)(az * az));
+    int16_t frame[DTW_FEATURES];
+    uint32_t bestCost = DTW_INF;
+    char symbol = 0;
+    uint8_t f, t;
+
+    d->sum[0] += gyro[0] >> 16;
+    d->sum[1] += gyro[1] >> 16;
+    d->sum[2] += gyro[2] >> 16;
+    d->sum[3] += ((norm - 1024) * 1000 >> 10) / 4;
+    if (++d->count < d->decimation) {
+        return 0;
+    }
+    for (f = 0; f < DTW_FEATURES; f++) {
+        frame[f] = (int16_t)(d->sum[f] / d->count);
+        d->sum[f] = 0;
+    }
+    d->count = 0;
+    d->frames++;
+
+    if (d->recordSlot >= 0) {
+        recordFrame(d, frame);
+        return 0;
+    }
+
+    // Run every template, the lowest distance per frame wins when several finish together
+    for (t = 0; t < DTW_MAX_TEMPLATES; t++) {
+        dtw_template_t *tpl = &d->templates[t];
+        dtw_matcher_t *m = &d->matchers[t];
+        if (tpl->length == 0) {
+            continue;
+        }
+        if (matchFrame(tpl, m, frame, d->frames)) {
+            uint32_t cost = m->best / tpl->length;
+            if (cost < bestCost) {
+                bestCost = cost;
+                symbol = tpl->symbol;
+                d->lastCost = m->best;
+            }
+            m->best = DTW_INF;
+        }
+    }
+
+    // A reported gesture consumes its frames for every template
+    if (symbol != 0) {
+        for (t = 0; t < DTW_MAX_TEMPLATES; t++) {
+            resetMatcher(&d->matchers[t]);
+        }
+    }
+    return symbol;
+}
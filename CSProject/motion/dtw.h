@@ -0,0 +1,76 @@
+/*
+ * dtw.h
+ *
+ *  Dynamic gesture recognizer: flicks, taps, shakes and other short motions
+ *  are matched against user-recorded templates with subsequence dynamic time
+ *  warping (SPRING), one template column per frame, so a gesture is reported
+ *  as soon as it ends without buffering a window.
+ *
+ *  IMU samples are averaged down to DTW_FRAME_HZ frames of DTW_FEATURES
+ *  values: gyro x, y, z in dps and the deviation of |a| from 1 g in mg / 4.
+ */
+
+#ifndef DTW_H_
+#define DTW_H_
+
+#include <stdint.h>
+
+#define DTW_FRAME_HZ       50
+#define DTW_FEATURES       4
+#define DTW_MAX_LEN        32    // Frames per template, 640 ms
+#define DTW_MIN_LEN        4
+#define DTW_MAX_TEMPLATES  4
+
+// Default match threshold per template frame, summed L1 feature distance
+#define DTW_FRAME_THRESHOLD  60
+
+// A match is reported at the latest this many frames after it ended, 100 ms
+#define DTW_SETTLE_FRAMES    5
+
+// Recording starts and ends on this much motion energy per frame
+#define DTW_RECORD_ENERGY    60
+
+typedef struct {
+    int16_t frame[DTW_MAX_LEN][DTW_FEATURES];
+    uint8_t length;        // 0 = empty slot
+    char symbol;           // Emitted on a match
+    uint32_t threshold;    // Max warped distance of a match
+} dtw_template_t;
+
+typedef struct {
+    uint32_t cost[DTW_MAX_LEN];   // Column of accumulated distances for the last frame
+    uint32_t start[DTW_MAX_LEN];  // Frame where the warping path of each cell starts
+    uint32_t best;                // Best candidate match not yet reported
+    uint32_t bestStart;
+    uint32_t bestEnd;
+} dtw_matcher_t;
+
+typedef struct {
+    dtw_template_t templates[DTW_MAX_TEMPLATES];
+    dtw_matcher_t matchers[DTW_MAX_TEMPLATES];
+
+    // Decimation from the IMU rate to frames
+    uint8_t decimation;
+    uint8_t count;
+    int32_t sum[DTW_FEATURES];
+    uint32_t frames;              // Frame counter, the time axis of the matchers
+
+    // Recording into a template slot, -1 when idle
+    int8_t recordSlot;
+    uint8_t recordQuiet;
+
+    uint32_t lastCost;            // Distance of the last reported match
+} dtw_t;
+
+void dtw_init(dtw_t *d, uint16_t rate_hz);
+void dtw_set_rate(dtw_t *d, uint16_t rate_hz);
+
+// Arm recording of a template: it starts with the next motion and ends when
+// the device is still again or the slot is full. Returns -1 on a bad slot
+int dtw_record(dtw_t *d, uint8_t slot, char symbol);
+
+// Feed one IMU sample, accel in g and gyro in dps both Q16.16. Returns the
+// symbol of a template that has just matched, 0 otherwise
+char dtw_update(dtw_t *d, const int32_t accel[3], const int32_t gyro[3]);
+
+#endif /* DTW_H_ */
@@ -0,0 +1,91 @@
+/*
+ * fixmath.c
+ *
+ *  Integer math kernels, see fixmath.h
+ */
+
+#include "motion/fixmath.h"
+
+// atan(z) = z (c1 + c3 z^2 + c5 z^4 + c7 z^6 + c9 z^8) for z in 0..1 in Q15,
+// Abramowitz & Stegun 4.4.47 (|error| < 1e-5 rad)
+#define ATAN_C1   32764
+#define ATAN_C3  -10823
+#define ATAN_C5    5903
+#define ATAN_C7   -2790
+#define ATAN_C9     683
+
+// Millidegrees per radian
+#define MDEG_PER_RAD  57296
+
+// atan of z = 0..32768 (Q15) in mdeg, 0..45000
+static int32_t atanOctant(int32_t z) {
+
+    int32_t z2 = (z * z) >> 15;
+    int32_t p = ATAN_C9;
+
+    p = ATAN_C7 + ((p * z2) >> 15);
+    p = ATAN_C5 + ((p * z2) >> 15);
+    p = ATAN_C3 + ((p * z2) >> 15);
+    p = ATAN_C1 + ((p * z2) >> 15);
+    p = (p * z) >> 15;                                  // radians, Q15
+    return (p * MDEG_PER_RAD + (1 << 14)) >> 15;
+}
+
+int32_t fix_atan2(int32_t y, int32_t x) {
+
+    uint32_t ay = y < 0 ? -(uint32_t)y : (uint32_t)y;
+    uint32_t ax = x < 0 ? -(uint32_t)x : (uint32_t)x;
+    int32_t angle;
+
+    if (ax == 0 && ay == 0) {
+        return 0;
+    }
+
+    // Scale both down to 16 bits so the ratio below fits in 32 bits
+    while ((ax | ay) > 0xFFFF) {
+        ax >>= 1;
+        ay >>= 1;
+    }
+
+    // First octant angle of z = min / max, then mirror around 45 degrees
+    if (ay <= ax) {
+        angle = atanOctant((int32_t)((ay << 15) / ax));
+    }
+    else {
+        angle = 90000 - atanOctant((int32_t)((ax << 15) / ay));
+    }
+
+    // Map the first octant result into the quadrant of (x, y)
+    if (x < 0) {
+        angle = FIX_MDEG_180 - angle;
+    }
+    return y < 0 ? -angle : angle;
+}
+
+uint16_t fix_sqrt(uint32_t x) {
+
+    uint32_t root = 0;
+    uint32_t bit = 1UL << 30;
+
+    while (bit > x) {
+        bit >>= 2;
+    }
+    while (bit != 0) {
+        if (x >= root + bit) {
+            x -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint16_t)root;
+}
+
+int32_t fix_wrap_mdeg(int32_t angle) {
+
+    while (angle > FIX_MDEG_180) angle -= FIX_MDEG_360;
+    while (angle < -FIX_MDEG_180) angle += FIX_MDEG_360;
+    return angle;
+}
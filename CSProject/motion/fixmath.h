@@ -0,0 +1,26 @@
+/*
+ * fixmath.h
+ *
+ *  Integer math kernels for the motion code, the Cortex-M3 has no FPU.
+ *  Angles are in millidegrees (mdeg).
+ */
+
+#ifndef FIXMATH_H_
+#define FIXMATH_H_
+
+#include <stdint.h>
+
+#define FIX_MDEG_180  180000
+#define FIX_MDEG_360  360000
+
+// Angle of the vector (x, y) in mdeg, -180000..180000. Error is below 10 mdeg
+// over the whole int32 range, one divide and five multiplies. atan2(0, 0) = 0
+int32_t fix_atan2(int32_t y, int32_t x);
+
+// Floor of the square root, exact for every uint32, 16 shift-subtract steps
+uint16_t fix_sqrt(uint32_t x);
+
+// Wrap an angle into -180000..180000
+int32_t fix_wrap_mdeg(int32_t angle);
+
+#endif /* FIXMATH_H_ */
@@ -0,0 +1,129 @@
+/*
+ * gesture.c
+ *
+ *  Hysteresis and dwell-time gesture state machine, see gesture.h
+ */
+
+#include "motion/gesture.h"
+#include "motion/sample_ring.h"  // SAMPLE_RING_BARRIER(), the queue crosses tasks the same way
+
+void gesture_init(gesture_t *g, const gesture_config_t *config, uint16_t rate_hz) {
+
+    g->config = config;
+    g->state = GESTURE_ARMED;
+    g->candidate = 0;
+    g->heldUs = 0;
+    g->head = 0;
+    g->tail = 0;
+    g->dropped = 0;
+    gesture_set_rate(g, rate_hz);
+}
+
+void gesture_set_rate(gesture_t *g, uint16_t rate_hz) {
+
+    g->periodUs = 1000000UL / rate_hz;
+}
+
+// Pose for the sample, using the enter thresholds or the looser exit thresholds
+static char pose(const gesture_config_t *c, int32_t roll, int32_t az, char held) {
+
+    int32_t absRoll = roll < 0 ? -roll : roll;
+    int32_t absAz = az < 0 ? -az : az;
+
+    if (held == ' ') {
+        return absAz >= c->spaceExit ? ' ' : 0;
+    }
+    if (held != 0) {
+        if (absRoll < c->rollExit || absRoll > c->rollMax) {
+            return 0;
+        }
+        return (roll > 0 ? '-' : '.') == held ? held : 0;
+    }
+    if (absAz >= c->spaceEnter) {
+        return ' ';
+    }
+    if (absRoll >= c->rollEnter && absRoll <= c->rollMax) {
+        return roll > 0 ? '-' : '.';
+    }
+    return 0;
+}
+
+void gesture_push(gesture_t *g, char symbol) {
+
+    uint8_t next = (g->head + 1) & (GESTURE_QUEUE_SIZE - 1);
+
+    if (next == g->tail) {
+        g->dropped++;
+        return;
+    }
+
+    // The slot is free only once the consumer's tail says so, and published only when written
+    SAMPLE_RING_BARRIER();
+    g->queue[g->head] = symbol;
+    SAMPLE_RING_BARRIER();
+    g->head = next;
+}
+
+void gesture_update(gesture_t *g, int32_t roll, int32_t az) {
+
+    const gesture_config_t *c = g->config;
+    char p;
+
+    switch (g->state) {
+
+    case GESTURE_ARMED:
+        g->candidate = pose(c, roll, az, 0);
+        if (g->candidate != 0) {
+            g->heldUs = 0;
+            g->state = GESTURE_CANDIDATE;
+        }
+        break;
+
+    case GESTURE_CANDIDATE:
+        p = pose(c, roll, az, g->candidate);
+        if (p == 0) {
+            // Left the pose before the dwell time, a glitch
+            g->state = GESTURE_ARMED;
+            break;
+        }
+        g->heldUs += g->periodUs;
+        if (g->heldUs >= (uint32_t)(p == ' ' ? c->spaceDwellMs : c->dwellMs) * 1000) {
+            gesture_push(g, p);
+            g->heldUs = 0;
+            g->state = GESTURE_LATCHED;
+        }
+        break;
+
+    case GESTURE_LATCHED: {
+        // Re-arm only after staying in neutral: level roll and no z spike
+        int32_t absRoll = roll < 0 ? -roll : roll;
+        int32_t absAz = az < 0 ? -az : az;
+        if (absRoll < c->rollNeutral && absAz < c->spaceExit) {
+            g->heldUs += g->periodUs;
+            if (g->heldUs >= (uint32_t)c->neutralMs * 1000) {
+                g->state = GESTURE_ARMED;
+            }
+        }
+        else {
+            g->heldUs = 0;
+        }
+        break;
+    }
+    }
+}
+
+char gesture_pop(gesture_t *g) {
+
+    char symbol;
+
+    if (g->tail == g->head) {
+        return 0;
+    }
+
+    // Read the slot after the head that published it, and hand it back only once it is read
+    SAMPLE_RING_BARRIER();
+    symbol = g->queue[g->tail];
+    SAMPLE_RING_BARRIER();
+    g->tail = (g->tail + 1) & (GESTURE_QUEUE_SIZE - 1);
+    return symbol;
+}
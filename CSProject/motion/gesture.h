@@ -0,0 +1,68 @@
+/*
+ * gesture.h
+ *
+ *  Morse input gestures from the fused orientation. A pose must be entered
+ *  past its enter threshold, held for the dwell time and then left through
+ *  neutral before the next symbol can start, so noise around a threshold
+ *  cannot emit repeated dots and dashes.
+ *
+ *    roll toward +90 deg  -> '-'
+ *    roll toward -90 deg  -> '.'
+ *    |az| spike past 1 g  -> ' '
+ */
+
+#ifndef GESTURE_H_
+#define GESTURE_H_
+
+#include <stdint.h>
+
+#define GESTURE_QUEUE_SIZE  16   // Power of two
+
+typedef struct {
+    int32_t rollEnter;     // mdeg, |roll| to enter the dot/dash pose
+    int32_t rollExit;      // mdeg, |roll| below this leaves the pose (< rollEnter)
+    int32_t rollMax;       // mdeg, |roll| above this is not a pose (device upside down)
+    int32_t rollNeutral;   // mdeg, |roll| below this counts as neutral for re-arming
+    int16_t spaceEnter;    // mg, |az| to enter the space gesture
+    int16_t spaceExit;     // mg, |az| below this leaves the space gesture
+    uint16_t dwellMs;      // Time a roll pose must be held
+    uint16_t spaceDwellMs; // Time the space spike must last
+    uint16_t neutralMs;    // Time in neutral before the next symbol is armed
+} gesture_config_t;
+
+// The old sensorListener() thresholds (60..120 deg, 1.25 g) with hysteresis added
+#define GESTURE_CONFIG_DEFAULT { 60000, 45000, 135000, 30000, 1250, 1100, 120, 20, 80 }
+
+typedef enum {
+    GESTURE_ARMED = 0,     // Neutral, waiting for a pose
+    GESTURE_CANDIDATE,     // In a pose, dwell time running
+    GESTURE_LATCHED        // Symbol emitted, waiting for neutral
+} gesture_state_t;
+
+typedef struct {
+    const gesture_config_t *config;
+    uint16_t periodUs;     // Sample period
+    gesture_state_t state;
+    char candidate;        // Symbol of the pose being held
+    uint32_t heldUs;       // Time in the current pose or in neutral
+
+    // Single producer (sensor task) / single consumer (UART task) symbol queue
+    char queue[GESTURE_QUEUE_SIZE];
+    volatile uint8_t head;
+    volatile uint8_t tail;
+    uint16_t dropped;      // Symbols lost to a full queue
+} gesture_t;
+
+void gesture_init(gesture_t *g, const gesture_config_t *config, uint16_t rate_hz);
+void gesture_set_rate(gesture_t *g, uint16_t rate_hz);
+
+// Feed one sample: roll in mdeg, az in mg
+void gesture_update(gesture_t *g, int32_t roll, int32_t az);
+
+// Queue a symbol from another recognizer, dropped when the queue is full
+void gesture_push(gesture_t *g, char symbol);
+
+// Next symbol from the queue, 0 when empty
+char gesture_pop(gesture_t *g);
+
+#endif /* GESTURE_H_ */
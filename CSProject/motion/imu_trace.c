@@ -0,0 +1,100 @@
+/*
+ * imu_trace.c
+ *
+ *  IMU trace encoding and decoding, see imu_trace.h
+ */
+
+#include <string.h>
+
+#include "motion/imu_trace.h"
+
+static const char traceMagic[4] = { 'I', 'M', 'U', 'T' };
+
+static void put16(uint8_t *buf, uint16_t value) {
+
+    buf[0] = value & 0xFF;
+    buf[1] = value >> 8;
+}
+
+static uint16_t get16(const uint8_t *buf) {
+
+    return buf[0] | (buf[1] << 8);
+}
+
+int imu_trace_write_header(uint8_t *buf, const imu_trace_header_t *header) {
+
+    memcpy(buf, traceMagic, sizeof(traceMagic));
+    buf[4] = header->version;
+    buf[5] = header->ascale;
+    buf[6] = header->gscale;
+    buf[7] = 0;
+    put16(&buf[8], header->rate);
+    put16(&buf[10], 0);
+    return IMU_TRACE_HEADER_SIZE;
+}
+
+int imu_trace_write_record(uint8_t *buf, const imu_trace_record_t *record) {
+
+    uint8_t sum = 0;
+    uint8_t i;
+
+    buf[0] = IMU_TRACE_SYNC;
+    buf[1] = record->seq;
+    put16(&buf[2], record->dtUs);
+    for (i = 0; i < 3; i++) {
+        put16(&buf[4 + 2 * i], (uint16_t)record->accel[i]);
+        put16(&buf[10 + 2 * i], (uint16_t)record->gyro[i]);
+    }
+    for (i = 1; i < IMU_TRACE_RECORD_SIZE - 1; i++) {
+        sum += buf[i];
+    }
+    buf[IMU_TRACE_RECORD_SIZE - 1] = sum;
+    return IMU_TRACE_RECORD_SIZE;
+}
+
+int imu_trace_read_header(const uint8_t *buf, int length, imu_trace_header_t *header) {
+
+    if (length < IMU_TRACE_HEADER_SIZE || memcmp(buf, traceMagic, sizeof(traceMagic)) != 0
+            || buf[4] != IMU_TRACE_VERSION) {
+        return 0;
+    }
+    header->version = buf[4];
+    header->ascale = buf[5];
+    header->gscale = buf[6];
+    header->rate = get16(&buf[8]);
+    return header->rate > 0 ? IMU_TRACE_HEADER_SIZE : 0;
+}
+
+int imu_trace_read_record(const uint8_t *buf, int length, imu_trace_record_t *record) {
+
+    uint8_t sum = 0;
+    uint8_t i;
+
+    if (length < IMU_TRACE_RECORD_SIZE || buf[0] != IMU_TRACE_SYNC) {
+        return 0;
+    }
+    for (i = 1; i < IMU_TRACE_RECORD_SIZE - 1; i++) {
+        sum += buf[i];
+    }
+    if (sum != buf[IMU_TRACE_RECORD_SIZE - 1]) {
+        return 0;
+    }
+    record->seq = buf[1];
+    record->dtUs = get16(&buf[2]);
+    for (i = 0; i < 3; i++) {
+        record->accel[i] = (int16_t)get16(&buf[4 + 2 * i]);
+        record->gyro[i] = (int16_t)get16(&buf[10 + 2 * i]);
+    }
+    return IMU_TRACE_RECORD_SIZE;
+}
+
+void imu_trace_scale_q16(const imu_trace_header_t *header, const imu_trace_record_t *record,
+                         int32_t accel[3], int32_t gyro[3]) {
+
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        accel[i] = (int32_t)record->accel[i] << (header->ascale + 2);
+        gyro[i] = (int32_t)record->gyro[i] * (500 << header->gscale);
+    }
+}
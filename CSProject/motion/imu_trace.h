@@ -0,0 +1,57 @@
+/*
+ * imu_trace.h
+ *
+ *  Binary IMU trace format, streamed over UART by "#capture" and read back
+ *  by the host replay tool (imu_replay.c). All fields are little endian.
+ *
+ *  Header, 12 bytes, sent when a capture starts and after a profile change:
+ *    "IMUT"  version  ascale  gscale  0  rate_hz(u16)  0(u16)
+ *
+ *  Record, 17 bytes per sample:
+ *    0xA5  seq  dt_us(u16)  accel xyz(i16)  gyro xyz(i16)  sum
+ *
+ *  seq counts samples modulo 256 so gaps show up on the host, dt_us is the
+ *  time since the previous sample (saturating, 0 for the first record of a
+ *  capture), sum is the 8-bit sum of the bytes between sync and sum. Samples
+ *  are raw counts as returned by mpu9250_get_data_raw(), ascale/gscale are
+ *  the driver's full-scale codes.
+ */
+
+#ifndef IMU_TRACE_H_
+#define IMU_TRACE_H_
+
+#include <stdint.h>
+
+#define IMU_TRACE_VERSION      1
+#define IMU_TRACE_HEADER_SIZE  12
+#define IMU_TRACE_RECORD_SIZE  17
+#define IMU_TRACE_SYNC         0xA5
+
+typedef struct {
+    uint8_t version;
+    uint8_t ascale;
+    uint8_t gscale;
+    uint16_t rate;
+} imu_trace_header_t;
+
+typedef struct {
+    uint8_t seq;
+    uint16_t dtUs;
+    int16_t accel[3];
+    int16_t gyro[3];
+} imu_trace_record_t;
+
+// Encoders return the number of bytes written to buf
+int imu_trace_write_header(uint8_t *buf, const imu_trace_header_t *header);
+int imu_trace_write_record(uint8_t *buf, const imu_trace_record_t *record);
+
+// Decoders return the bytes consumed, 0 when buf does not start with a valid
+// header or record (the reader then skips one byte to resync)
+int imu_trace_read_header(const uint8_t *buf, int length, imu_trace_header_t *header);
+int imu_trace_read_record(const uint8_t *buf, int length, imu_trace_record_t *record);
+
+// Raw counts to g and dps in Q16.16 at the header's full scale, same as mpu9250_scale_q16()
+void imu_trace_scale_q16(const imu_trace_header_t *header, const imu_trace_record_t *record,
+                         int32_t accel[3], int32_t gyro[3]);
+
+#endif /* IMU_TRACE_H_ */
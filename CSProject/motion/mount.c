@@ -0,0 +1,227 @@
+/*
+ * mount.c
+ *
+ *  Mounting calibration, see mount.h
+ */
+
+#include "motion/mount.h"
+#include "motion/fixmath.h"
+
+// Still: every gyro axis below this and |a| within 0.9..1.1 g (squared, mg)
+#define MOUNT_STILL_DPS  10
+#define MOUNT_G2_MIN     (900L * 900L)
+#define MOUNT_G2_MAX     (1100L * 1100L)
+
+static const char *stepNames[] = { "idle", "neutral", "dot", "dash", "space", "done", "failed" };
+
+void mount_init(mount_t *m) {
+
+    uint8_t i, j;
+
+    for (i = 0; i < 3; i++) {
+        for (j = 0; j < 3; j++) {
+            m->rot[i][j] = i == j ? MOUNT_ONE : 0;
+        }
+    }
+    m->dotReach = 0;
+    m->dashReach = 0;
+    m->spacePeak = 0;
+    m->valid = 0;
+    m->reserved = 0;
+}
+
+void mount_apply(const mount_t *m, int32_t accel[3], int32_t gyro[3]) {
+
+    int32_t a[3], g[3];
+    uint8_t i;
+
+    if (!m->valid) {
+        return;
+    }
+    for (i = 0; i < 3; i++) {
+        a[i] = accel[i];
+        g[i] = gyro[i];
+    }
+    for (i = 0; i < 3; i++) {
+        accel[i] = (int32_t)(((int64_t)m->rot[i][0] * a[0] + (int64_t)m->rot[i][1] * a[1]
+                              + (int64_t)m->rot[i][2] * a[2]) >> 14);
+        gyro[i] = (int32_t)(((int64_t)m->rot[i][0] * g[0] + (int64_t)m->rot[i][1] * g[1]
+                             + (int64_t)m->rot[i][2] * g[2]) >> 14);
+    }
+}
+
+void mount_gesture_config(const mount_t *m, const gesture_config_t *base, gesture_config_t *config) {
+
+    int32_t reach = m->dotReach < m->dashReach ? m->dotReach : m->dashReach;
+    int32_t jerk = m->spacePeak - 1000;
+
+    *config = *base;
+    if (!m->valid) {
+        return;
+    }
+
+    // Keep the proportions of base, which assume a 90 degree reach and a 1.375 g jerk
+    config->rollEnter = (int32_t)((int64_t)base->rollEnter * reach / 90000);
+    config->rollExit = (int32_t)((int64_t)base->rollExit * reach / 90000);
+    config->rollNeutral = (int32_t)((int64_t)base->rollNeutral * reach / 90000);
+    config->rollMax = reach + (base->rollMax - 90000) < 175000 ? reach + (base->rollMax - 90000) : 175000;
+    config->spaceEnter = 1000 + (base->spaceEnter - 1000) * jerk / 375;
+    config->spaceExit = 1000 + (base->spaceExit - 1000) * jerk / 375;
+}
+
+void mount_cal_start(mount_cal_t *c, uint16_t rate_hz) {
+
+    mount_init(&c->result);
+    c->periodUs = 1000000UL / rate_hz;
+    c->stepUs = 0;
+    c->stillUs = 0;
+    c->sum[0] = c->sum[1] = c->sum[2] = 0;
+    c->count = 0;
+    c->peak = 0;
+    c->step = MOUNT_CAL_NEUTRAL;
+}
+
+// Unit vector in Q14, 0 when v is too short to have a direction
+static int normalize(const int32_t v[3], int16_t out[3]) {
+
+    uint16_t length = fix_sqrt((uint32_t)(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]));
+    uint8_t i;
+
+    if (length < 100) {
+        return 0;
+    }
+    for (i = 0; i < 3; i++) {
+        out[i] = (int16_t)(v[i] * MOUNT_ONE / length);
+    }
+    return 1;
+}
+
+// Component of v (mg) along the Q14 unit vector u
+static int32_t along(const int16_t u[3], const int32_t v[3]) {
+
+    return (u[0] * v[0] + u[1] * v[1] + u[2] * v[2]) >> 14;
+}
+
+static void nextStep(mount_cal_t *c, mount_cal_step_t step) {
+
+    c->stepUs = 0;
+    c->step = step;
+}
+
+// Dot pose: tilt angle away from neutral in mdeg, and the canonical frame when it is far enough
+static void takeDot(mount_cal_t *c, const int32_t pose[3]) {
+
+    int16_t *x = c->result.rot[0], *y = c->result.rot[1], *z = c->result.rot[2];
+    int32_t perp[3];
+    int32_t up = along(z, pose);
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        perp[i] = -(pose[i] - ((up * z[i]) >> 14));
+    }
+    int32_t reach = fix_atan2(fix_sqrt((uint32_t)(perp[0] * perp[0] + perp[1] * perp[1] + perp[2] * perp[2])), up);
+    if (reach < MOUNT_MIN_REACH || !normalize(perp, y)) {
+        return;  // Still near neutral, keep waiting
+    }
+
+    // Right handed: x = y cross z
+    x[0] = (int16_t)((y[1] * z[2] - y[2] * z[1]) >> 14);
+    x[1] = (int16_t)((y[2] * z[0] - y[0] * z[2]) >> 14);
+    x[2] = (int16_t)((y[0] * z[1] - y[1] * z[0]) >> 14);
+    c->result.dotReach = reach;
+    nextStep(c, MOUNT_CAL_DASH);
+}
+
+mount_cal_step_t mount_cal_update(mount_cal_t *c, const int32_t accel[3], const int32_t gyro[3]) {
+
+    int32_t mg[3], pose[3];
+    uint8_t i, still = 1;
+
+    if (c->step == MOUNT_CAL_IDLE || c->step == MOUNT_CAL_DONE || c->step == MOUNT_CAL_FAILED) {
+        return c->step;
+    }
+
+    c->stepUs += c->periodUs;
+    if (c->stepUs > MOUNT_STEP_TIMEOUT_S * 1000000UL) {
+        c->step = MOUNT_CAL_FAILED;
+        return c->step;
+    }
+
+    for (i = 0; i < 3; i++) {
+        mg[i] = ((accel[i] >> 6) * 1000) >> 10;
+        if (gyro[i] > (MOUNT_STILL_DPS << 16) || gyro[i] < -(MOUNT_STILL_DPS << 16)) {
+            still = 0;
+        }
+    }
+    int32_t g2 = mg[0] * mg[0] + mg[1] * mg[1] + mg[2] * mg[2];
+    if (g2 < MOUNT_G2_MIN || g2 > MOUNT_G2_MAX) {
+        still = 0;
+    }
+
+    // The space jerk is measured along canonical z, the dot step has built the frame by now
+    if (c->step == MOUNT_CAL_SPACE) {
+        int32_t az = along(c->result.rot[2], mg);
+        if (az < 0) az = -az;
+        if (az > c->peak) c->peak = az > 0x7FFF ? 0x7FFF : (int16_t)az;
+    }
+
+    // A pose is the average over MOUNT_HOLD_MS of stillness, any motion starts over
+    if (!still) {
+        c->stillUs = 0;
+        c->sum[0] = c->sum[1] = c->sum[2] = 0;
+        c->count = 0;
+        return c->step;
+    }
+    for (i = 0; i < 3; i++) {
+        c->sum[i] += mg[i];
+    }
+    c->count++;
+    c->stillUs += c->periodUs;
+    if (c->stillUs < MOUNT_HOLD_MS * 1000UL) {
+        return c->step;
+    }
+    for (i = 0; i < 3; i++) {
+        pose[i] = c->sum[i] / c->count;
+        c->sum[i] = 0;
+    }
+    c->count = 0;
+    c->stillUs = 0;
+
+    switch (c->step) {
+    case MOUNT_CAL_NEUTRAL:
+        if (normalize(pose, c->result.rot[2])) {
+            nextStep(c, MOUNT_CAL_DOT);
+        }
+        break;
+
+    case MOUNT_CAL_DOT:
+        takeDot(c, pose);
+        break;
+
+    case MOUNT_CAL_DASH:
+        // The dash pose has to be on the other side, i.e. positive roll in the new frame
+        c->result.dashReach = fix_atan2(along(c->result.rot[1], pose), along(c->result.rot[2], pose));
+        if (c->result.dashReach >= MOUNT_MIN_REACH) {
+            c->peak = 0;
+            nextStep(c, MOUNT_CAL_SPACE);
+        }
+        break;
+
+    case MOUNT_CAL_SPACE:
+        if (c->peak >= MOUNT_SPACE_MIN) {
+            c->result.spacePeak = c->peak;
+            c->result.valid = 1;
+            nextStep(c, MOUNT_CAL_DONE);
+        }
+        break;
+
+    default:
+        break;
+    }
+    return c->step;
+}
+
+const char *mount_cal_step_name(mount_cal_step_t step) {
+
+    return step <= MOUNT_CAL_FAILED ? stepNames[step] : "?";
+}
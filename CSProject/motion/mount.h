@@ -0,0 +1,83 @@
+/*
+ * mount.h
+ *
+ *  Mounting calibration: the tag is rarely worn with z vertical and x along
+ *  the roll axis the gesture thresholds assume. A short guided sequence
+ *  learns the neutral pose, the dot and dash poses and a space jerk, builds
+ *  the rotation from the sensor frame into a canonical one (neutral gravity
+ *  on +z, dot tilt toward -y) and records how far this user actually tilts,
+ *  so the thresholds can be scaled to their reach.
+ *
+ *    neutral  hold still in the rest pose
+ *    dot      tilt to the dot side and hold still
+ *    dash     tilt to the dash side and hold still
+ *    space    do one space jerk, then hold still
+ *
+ *  A pose is taken once the device has been still for MOUNT_HOLD_MS. The
+ *  result is a plain struct, the firmware persists it in flash_store.
+ */
+
+#ifndef MOUNT_H_
+#define MOUNT_H_
+
+#include <stdint.h>
+
+#include "motion/gesture.h"
+
+#define MOUNT_VERSION        1      // Bump when mount_t changes, flash_store drops old records
+#define MOUNT_ONE            16384  // 1.0 in the Q14 rotation matrix
+#define MOUNT_HOLD_MS        1000   // Stillness needed to take a pose
+#define MOUNT_STEP_TIMEOUT_S 20     // A step not completed in time fails the calibration
+#define MOUNT_MIN_REACH      30000  // mdeg, dot and dash poses must be at least this far from neutral
+#define MOUNT_SPACE_MIN      1150   // mg, weakest accepted space jerk along canonical z
+
+typedef struct {
+    int16_t rot[3][3];     // Sensor to canonical frame, Q14, rows are the canonical axes
+    int32_t dotReach;      // mdeg, |roll| of the calibrated dot pose
+    int32_t dashReach;     // mdeg, roll of the calibrated dash pose
+    int16_t spacePeak;     // mg, peak canonical |az| of the calibrated space jerk
+    uint8_t valid;         // 0: identity rotation and default thresholds
+    uint8_t reserved;
+} mount_t;
+
+typedef enum {
+    MOUNT_CAL_IDLE = 0,
+    MOUNT_CAL_NEUTRAL,
+    MOUNT_CAL_DOT,
+    MOUNT_CAL_DASH,
+    MOUNT_CAL_SPACE,
+    MOUNT_CAL_DONE,        // result is valid
+    MOUNT_CAL_FAILED       // Timed out or the poses were too close together
+} mount_cal_step_t;
+
+typedef struct {
+    volatile mount_cal_step_t step;
+    uint16_t periodUs;
+    uint32_t stepUs;       // Time in the current step
+    uint32_t stillUs;      // Time the device has been still
+    int32_t sum[3];        // mg, accelerometer summed while still
+    uint16_t count;
+    int16_t peak;          // mg, space jerk so far
+    mount_t result;
+} mount_cal_t;
+
+// Identity rotation, not valid
+void mount_init(mount_t *m);
+
+// Rotate one sample into the canonical frame, accel and gyro Q16.16 in place
+void mount_apply(const mount_t *m, int32_t accel[3], int32_t gyro[3]);
+
+// Thresholds for a mounting: base scaled from the nominal 90 degree reach and
+// 1.375 g jerk to the calibrated ones, or base unchanged when m is not valid.
+// base stays the unscaled config the user tunes
+void mount_gesture_config(const mount_t *m, const gesture_config_t *base, gesture_config_t *config);
+
+// Start the guided sequence, then feed raw sensor-frame samples until
+// step is MOUNT_CAL_DONE or MOUNT_CAL_FAILED
+void mount_cal_start(mount_cal_t *c, uint16_t rate_hz);
+mount_cal_step_t mount_cal_update(mount_cal_t *c, const int32_t accel[3], const int32_t gyro[3]);
+
+// Name of a step for prompts, e.g. "dot"
+const char *mount_cal_step_name(mount_cal_step_t step);
+
+#endif /* MOUNT_H_ */
@@ -0,0 +1,72 @@
+/*
+ * orientation.c
+ *
+ *  Complementary filter, see orientation.h
+ */
+
+#include "motion/orientation.h"
+#include "motion/fixmath.h"
+
+// Share of the accelerometer tilt blended in per sample, Q15 (about 0.02)
+#define ORIENTATION_ACCEL_GAIN  655
+
+// Accelerometer is trusted only while |a| is within 0.8..1.2 g, squared in Q20
+#define ORIENTATION_G2_MIN  ((1024 * 8 / 10) * (1024 * 8 / 10))
+#define ORIENTATION_G2_MAX  ((1024 * 12 / 10) * (1024 * 12 / 10))
+
+void orientation_init(orientation_t *o, uint16_t rate_hz) {
+
+    o->roll = 0;
+    o->pitch = 0;
+    o->yaw = 0;
+    o->started = 0;
+    orientation_set_rate(o, rate_hz);
+}
+
+void orientation_set_rate(orientation_t *o, uint16_t rate_hz) {
+
+    o->dtQ24 = (1UL << 24) / rate_hz;
+}
+
+// Angle change over one sample period in mdeg from a Q16.16 dps rate
+static int32_t gyroDelta(const orientation_t *o, int32_t gyro) {
+
+    int32_t mdps = ((gyro >> 6) * 125) >> 7;  // * 1000 / 65536
+    return (int32_t)(((int64_t)mdps * o->dtQ24) >> 24);
+}
+
+// Move angle toward target by the accelerometer gain, along the shorter way around
+static int32_t blend(int32_t angle, int32_t target) {
+
+    int32_t error = fix_wrap_mdeg(target - angle);
+    return fix_wrap_mdeg(angle + ((error * ORIENTATION_ACCEL_GAIN) >> 15));
+}
+
+void orientation_update(orientation_t *o, const int32_t accel[3], const int32_t gyro[3]) {
+
+    // Accelerometer in Q10 g keeps the squares below within 32 bits up to 16 g
+    int32_t ax = accel[0] >> 6, ay = accel[1] >> 6, az = accel[2] >> 6;
+    uint32_t yz2 = (uint32_t)(ay * ay) + (uint32_t)(az * az);
+    uint32_t g2 = yz2 + (uint32_t)(ax * ax);
+
+    int32_t accRoll = fix_atan2(ay, az);
+    int32_t accPitch = fix_atan2(-ax, fix_sqrt(yz2));
+
+    if (!o->started) {
+        o->roll = accRoll;
+        o->pitch = accPitch;
+        o->started = 1;
+        return;
+    }
+
+    // Propagate with the gyro
+    o->roll = fix_wrap_mdeg(o->roll + gyroDelta(o, gyro[0]));
+    o->pitch = fix_wrap_mdeg(o->pitch + gyroDelta(o, gyro[1]));
+    o->yaw = fix_wrap_mdeg(o->yaw + gyroDelta(o, gyro[2]));
+
+    // Correct roll and pitch drift with gravity unless the device is accelerating
+    if (g2 >= ORIENTATION_G2_MIN && g2 <= ORIENTATION_G2_MAX) {
+        o->roll = blend(o->roll, accRoll);
+        o->pitch = blend(o->pitch, accPitch);
+    }
+}
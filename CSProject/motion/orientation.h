@@ -0,0 +1,29 @@
+/*
+ * orientation.h
+ *
+ *  Gyro-aided orientation: a fixed-point complementary filter that integrates
+ *  the gyro at the full IMU rate and pulls roll and pitch toward the
+ *  accelerometer tilt whenever the measured acceleration is close to 1 g.
+ *  Yaw is integrated gyro only and drifts slowly.
+ */
+
+#ifndef ORIENTATION_H_
+#define ORIENTATION_H_
+
+#include <stdint.h>
+
+typedef struct {
+    int32_t roll;    // mdeg, rotation about x, atan2(ay, az) at rest
+    int32_t pitch;   // mdeg, rotation about y
+    int32_t yaw;     // mdeg, rotation about z
+    uint32_t dtQ24;  // Sample period in seconds, Q8.24
+    uint8_t started; // First update takes the accelerometer tilt as is
+} orientation_t;
+
+void orientation_init(orientation_t *o, uint16_t rate_hz);
+void orientation_set_rate(orientation_t *o, uint16_t rate_hz);
+
+// accel in g and gyro in dps, both Q16.16 as from mpu9250_scale_q16()
+void orientation_update(orientation_t *o, const int32_t accel[3], const int32_t gyro[3]);
+
+#endif /* ORIENTATION_H_ */
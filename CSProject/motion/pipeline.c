@@ -0,0 +1,90 @@
+/*
+ * pipeline.c
+ *
+ *  Gesture pipeline, see pipeline.h
+ */
+
+#include <stddef.h>
+
+#include "motion/pipeline.h"
+
+void pipeline_init(pipeline_t *p, const gesture_config_t *gesture, const tapkey_config_t *tap, uint16_t rate_hz) {
+
+    p->mode = PIPELINE_TILT;
+    p->rate = rate_hz;
+    mount_init(&p->mount);
+    p->mountCal.step = MOUNT_CAL_IDLE;
+    orientation_init(&p->orientation, rate_hz);
+    gesture_init(&p->gesture, gesture, rate_hz);
+    dtw_init(&p->dtw, rate_hz);
+    tapkey_init(&p->tapkey, tap, rate_hz);
+}
+
+void pipeline_set_rate(pipeline_t *p, uint16_t rate_hz) {
+
+    p->rate = rate_hz;
+    orientation_set_rate(&p->orientation, rate_hz);
+    gesture_set_rate(&p->gesture, rate_hz);
+    dtw_set_rate(&p->dtw, rate_hz);
+    tapkey_set_rate(&p->tapkey, rate_hz);
+}
+
+void pipeline_set_mode(pipeline_t *p, pipeline_mode_t mode) {
+
+    // The keyer is idle in tilt mode, restart it before it sees samples again
+    if (mode == PIPELINE_TAP && p->mode != PIPELINE_TAP) {
+        tapkey_init(&p->tapkey, p->tapkey.config, p->rate);
+    }
+    p->mode = mode;
+}
+
+void pipeline_set_mount(pipeline_t *p, const mount_t *mount) {
+
+    if (mount != NULL) {
+        p->mount = *mount;
+    }
+    else {
+        mount_init(&p->mount);
+    }
+    p->orientation.started = 0;
+}
+
+void pipeline_calibrate_mount(pipeline_t *p) {
+
+    mount_cal_start(&p->mountCal, p->rate);
+}
+
+void pipeline_update(pipeline_t *p, const int32_t accel[3], const int32_t gyro[3]) {
+
+    int32_t a[3] = { accel[0], accel[1], accel[2] };
+    int32_t g[3] = { gyro[0], gyro[1], gyro[2] };
+    char symbol;
+
+    // The calibration sees raw sensor axes and no symbols are recognized meanwhile
+    if (p->mountCal.step != MOUNT_CAL_IDLE && p->mountCal.step != MOUNT_CAL_DONE
+            && p->mountCal.step != MOUNT_CAL_FAILED) {
+        if (mount_cal_update(&p->mountCal, accel, gyro) == MOUNT_CAL_DONE) {
+            pipeline_set_mount(p, &p->mountCal.result);
+        }
+        return;
+    }
+
+    mount_apply(&p->mount, a, g);
+    orientation_update(&p->orientation, a, g);
+
+    if (p->mode == PIPELINE_TAP) {
+        symbol = tapkey_update(&p->tapkey, a);
+    }
+    else {
+        gesture_update(&p->gesture, p->orientation.roll, ((a[2] >> 6) * 1000) >> 10);
+        symbol = dtw_update(&p->dtw, a, g);
+    }
+    if (symbol) {
+        gesture_push(&p->gesture, symbol);
+    }
+}
+
+char pipeline_pop(pipeline_t *p) {
+
+    return gesture_pop(&p->gesture);
+}
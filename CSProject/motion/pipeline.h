@@ -0,0 +1,56 @@
+/*
+ * pipeline.h
+ *
+ *  The gesture pipeline behind sensorListener(): mounting rotation,
+ *  orientation filter, tilt gesture state machine, DTW templates and tap
+ *  keyer, fed one IMU sample at a time. Plain C shared by the firmware and
+ *  the host replay tool (imu_replay.c), so a recorded trace produces the
+ *  same symbols on both.
+ */
+
+#ifndef PIPELINE_H_
+#define PIPELINE_H_
+
+#include <stdint.h>
+
+#include "motion/orientation.h"
+#include "motion/gesture.h"
+#include "motion/dtw.h"
+#include "motion/tapkey.h"
+#include "motion/mount.h"
+
+// Morse input mode: tilt and motion gestures, or tapping like a straight key
+typedef enum {
+    PIPELINE_TILT = 0,
+    PIPELINE_TAP
+} pipeline_mode_t;
+
+typedef struct {
+    mount_t mount;                // Applied to every sample before recognition
+    mount_cal_t mountCal;         // Recognition pauses while a calibration runs
+    orientation_t orientation;
+    gesture_t gesture;            // Also holds the symbol queue of every mode
+    dtw_t dtw;
+    tapkey_t tapkey;
+    volatile pipeline_mode_t mode;
+    uint16_t rate;
+} pipeline_t;
+
+void pipeline_init(pipeline_t *p, const gesture_config_t *gesture, const tapkey_config_t *tap, uint16_t rate_hz);
+void pipeline_set_rate(pipeline_t *p, uint16_t rate_hz);
+void pipeline_set_mode(pipeline_t *p, pipeline_mode_t mode);
+
+// Replace the mounting rotation, NULL restores the identity
+void pipeline_set_mount(pipeline_t *p, const mount_t *mount);
+
+// Run the mounting calibration on the next samples, the result is installed
+// when mountCal.step reaches MOUNT_CAL_DONE
+void pipeline_calibrate_mount(pipeline_t *p);
+
+// Feed one sample, accel in g and gyro in dps both Q16.16
+void pipeline_update(pipeline_t *p, const int32_t accel[3], const int32_t gyro[3]);
+
+// Next Morse symbol recognized, 0 when none
+char pipeline_pop(pipeline_t *p);
+
+#endif /* PIPELINE_H_ */
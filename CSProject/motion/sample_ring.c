@@ -0,0 +1,80 @@
+/*
+ * sample_ring.c
+ *
+ *  Single-producer, multi-reader sample ring, see sample_ring.h
+ */
+
+#include "motion/sample_ring.h"
+
+void sample_ring_init(sample_ring_t *r) {
+
+    r->head = 0;
+}
+
+void sample_ring_push(sample_ring_t *r, const imu_sample_t *sample) {
+
+    uint32_t head = r->head;
+
+    r->slot[head & (SAMPLE_RING_SIZE - 1)] = *sample;
+
+    // Publish the slot only after its contents are written
+    SAMPLE_RING_BARRIER();
+    r->head = head + 1;
+}
+
+void sample_reader_init(sample_reader_t *rd, const sample_ring_t *r) {
+
+    rd->ring = r;
+    rd->cursor = r->head;
+    rd->overflows = 0;
+}
+
+int sample_reader_next(sample_reader_t *rd, imu_sample_t *out) {
+
+    const sample_ring_t *r = rd->ring;
+
+    while (1) {
+        uint32_t head = r->head;
+
+        if (rd->cursor == head) {
+            return 0;
+        }
+        // The slot at head may be mid-write, so SAMPLE_RING_SIZE - 1 samples are readable
+        if (head - rd->cursor >= SAMPLE_RING_SIZE) {
+            rd->overflows += head - rd->cursor - (SAMPLE_RING_SIZE - 1);
+            rd->cursor = head - (SAMPLE_RING_SIZE - 1);
+        }
+
+        SAMPLE_RING_BARRIER();
+        *out = r->slot[rd->cursor & (SAMPLE_RING_SIZE - 1)];
+        SAMPLE_RING_BARRIER();
+
+        // The producer may have lapped the slot while it was copied, then retry
+        if (r->head - rd->cursor < SAMPLE_RING_SIZE) {
+            rd->cursor++;
+            return 1;
+        }
+    }
+}
+
+int sample_reader_latest(sample_reader_t *rd, imu_sample_t *out) {
+
+    const sample_ring_t *r = rd->ring;
+
+    while (1) {
+        uint32_t head = r->head;
+
+        if (rd->cursor == head) {
+            return 0;
+        }
+
+        SAMPLE_RING_BARRIER();
+        *out = r->slot[(head - 1) & (SAMPLE_RING_SIZE - 1)];
+        SAMPLE_RING_BARRIER();
+
+        if (r->head - (head - 1) < SAMPLE_RING_SIZE) {
+            rd->cursor = head;
+            return 1;
+        }
+    }
+}
@@ -0,0 +1,56 @@
+/*
+ * sample_ring.h
+ *
+ *  Lock-free ring of timestamped IMU samples: one producer (the sensor task)
+ *  and any number of readers, each with its own cursor. The producer never
+ *  waits; a reader that falls more than a ring behind loses the oldest
+ *  samples and counts them as overflows. Slow consumers such as telemetry
+ *  jump to the newest sample instead of reading every one.
+ *
+ *  Plain C, no TI headers, so the ring also runs on the host.
+ */
+
+#ifndef SAMPLE_RING_H_
+#define SAMPLE_RING_H_
+
+#include <stdint.h>
+
+#define SAMPLE_RING_SIZE  64   // Power of two, 320 ms at 200 Hz
+
+#if defined(__TI_COMPILER_VERSION__)
+#define SAMPLE_RING_BARRIER()  __asm(" dmb")
+#else
+#define SAMPLE_RING_BARRIER()  __sync_synchronize()
+#endif
+
+typedef struct {
+    uint32_t time;        // Timestamp ticks of the data-ready edge
+    int16_t accel[3];     // Raw, bias corrected, as from mpu9250_get_data_raw()
+    int16_t gyro[3];
+} imu_sample_t;
+
+typedef struct {
+    imu_sample_t slot[SAMPLE_RING_SIZE];
+    volatile uint32_t head;   // Samples written so far, wraps
+} sample_ring_t;
+
+typedef struct {
+    const sample_ring_t *ring;
+    uint32_t cursor;          // Next sample to read
+    uint32_t overflows;       // Samples overwritten before this reader got them
+} sample_reader_t;
+
+void sample_ring_init(sample_ring_t *r);
+void sample_ring_push(sample_ring_t *r, const imu_sample_t *sample);
+
+// A new reader starts at the newest sample
+void sample_reader_init(sample_reader_t *rd, const sample_ring_t *r);
+
+// Next unread sample, returns 0 when the reader is up to date
+int sample_reader_next(sample_reader_t *rd, imu_sample_t *out);
+
+// Newest sample, skipping the unread ones without counting them lost.
+// Returns 0 when nothing new arrived since the last read
+int sample_reader_latest(sample_reader_t *rd, imu_sample_t *out);
+
+#endif /* SAMPLE_RING_H_ */
@@ -0,0 +1,56 @@
+/*
+ * sample_timing.c
+ *
+ *  Data-ready interrupt statistics, see sample_timing.h
+ */
+
+#include "motion/sample_timing.h"
+
+void sample_timing_init(sample_timing_t *t) {
+
+    t->stamp = 0;
+    t->previous = 0;
+    sample_timing_reset(t);
+}
+
+void sample_timing_reset(sample_timing_t *t) {
+
+    t->periodMin = 0xFFFFFFFF;
+    t->periodMax = 0;
+    t->latencyMax = 0;
+    t->latencySum = 0;
+    t->samples = 0;
+    t->timeouts = 0;
+}
+
+void sample_timing_edge(sample_timing_t *t, uint32_t now) {
+
+    if (t->previous != 0) {
+        uint32_t period = now - t->previous;
+        if (period < t->periodMin) t->periodMin = period;
+        if (period > t->periodMax) t->periodMax = period;
+    }
+    t->previous = now;
+    t->stamp = now;
+}
+
+void sample_timing_sample(sample_timing_t *t, uint32_t stamp, uint32_t now) {
+
+    uint32_t latency = now - stamp;
+
+    if (latency > t->latencyMax) t->latencyMax = latency;
+    t->latencySum += latency;
+    t->samples++;
+}
+
+void sample_timing_timeout(sample_timing_t *t) {
+
+    t->timeouts++;
+    t->samples++;
+}
+
+uint32_t sample_timing_us(uint32_t ticks, uint32_t hz) {
+
+    // The CC26xx default Timestamp runs off the 65536 Hz RTC, below one tick per microsecond
+    return (uint32_t)((uint64_t)ticks * 1000000 / hz);
+}
@@ -0,0 +1,43 @@
+/*
+ * sample_timing.h
+ *
+ *  Data-ready interrupt statistics for the sensor task: the interval between
+ *  interrupt edges (jitter), the time from an edge until its sample has been
+ *  read (latency) and pend timeouts, all in Timestamp ticks. The interrupt
+ *  calls sample_timing_edge(), the task the rest.
+ *
+ *  Plain C, no TI headers, so the host simulation (mpu_irq_sim.c) runs it
+ *  against a fake interrupt source.
+ */
+
+#ifndef SAMPLE_TIMING_H_
+#define SAMPLE_TIMING_H_
+
+#include <stdint.h>
+
+typedef struct {
+    volatile uint32_t stamp;     // Time of the newest edge
+    uint32_t previous;           // Edge before it, 0 until the first edge
+    uint32_t periodMin, periodMax;
+    uint32_t latencyMax, latencySum;
+    uint32_t samples, timeouts;
+} sample_timing_t;
+
+void sample_timing_init(sample_timing_t *t);
+
+// Start a new statistics window, the edge history is kept
+void sample_timing_reset(sample_timing_t *t);
+
+// Interrupt context: one data-ready edge at now
+void sample_timing_edge(sample_timing_t *t, uint32_t now);
+
+// A sample was read at now after waking on the edge stamped stamp
+void sample_timing_sample(sample_timing_t *t, uint32_t stamp, uint32_t now);
+
+// The wait for an edge timed out and a sample was read without one
+void sample_timing_timeout(sample_timing_t *t);
+
+// Ticks at hz to microseconds, exact for any Timestamp frequency
+uint32_t sample_timing_us(uint32_t ticks, uint32_t hz);
+
+#endif /* SAMPLE_TIMING_H_ */
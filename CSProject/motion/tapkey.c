@@ -0,0 +1,94 @@
+/*
+ * tapkey.c
+ *
+ *  Tap-duration Morse keying, see tapkey.h
+ */
+
+#include "motion/tapkey.h"
+#include "motion/fixmath.h"
+
+void tapkey_init(tapkey_t *k, const tapkey_config_t *config, uint16_t rate_hz) {
+
+    k->config = config;
+    k->down = 0;
+    k->sinceUs = (uint32_t)config->deadMs * 1000;
+    k->dotUs = (uint32_t)config->dotMs * 1000;
+    k->elements = 0;
+    k->gaps = 2;
+    tapkey_set_rate(k, rate_hz);
+}
+
+void tapkey_set_rate(tapkey_t *k, uint16_t rate_hz) {
+
+    k->periodUs = 1000000UL / rate_hz;
+}
+
+// Classify a finished element and move the dot estimate a quarter of the way toward it
+static char element(tapkey_t *k, uint32_t durationUs) {
+
+    const tapkey_config_t *c = k->config;
+    char symbol = durationUs < 2 * k->dotUs ? '.' : '-';
+    uint32_t dot = symbol == '.' ? durationUs : durationUs / 3;
+
+    k->dotUs = (3 * k->dotUs + dot) / 4;
+    if (k->dotUs < (uint32_t)c->dotMinMs * 1000) {
+        k->dotUs = (uint32_t)c->dotMinMs * 1000;
+    }
+    if (k->dotUs > (uint32_t)c->dotMaxMs * 1000) {
+        k->dotUs = (uint32_t)c->dotMaxMs * 1000;
+    }
+    k->elements++;
+    k->gaps = 0;
+    return symbol;
+}
+
+char tapkey_update(tapkey_t *k, const int32_t accel[3]) {
+
+    const tapkey_config_t *c = k->config;
+    int32_t ax = accel[0] >> 6, ay = accel[1] >> 6, az = accel[2] >> 6;  // Q10 g
+    int32_t norm = fix_sqrt((uint32_t)(ax * ax) + (uint32_t)(ay * ay) + (uint32_t)(az * az));
+    int32_t impact = ((norm - 1024) * 1000) >> 10;                         // mg
+
+    // Saturate instead of wrapping after an hour of silence
+    if (k->sinceUs < 0xF0000000UL) {
+        k->sinceUs += k->periodUs;
+    }
+    if (impact < 0) {
+        impact = -impact;
+    }
+
+    // A tap outside the ringing of the previous one toggles the key
+    if (impact >= c->impactMg && k->sinceUs >= (uint32_t)c->deadMs * 1000) {
+        uint32_t duration = k->sinceUs;
+        k->sinceUs = 0;
+        k->down = !k->down;
+        return k->down ? 0 : element(k, duration);
+    }
+
+    if (k->down) {
+        // A missed release would hold the key forever, close it as a dash
+        if (k->sinceUs >= 7 * k->dotUs) {
+            k->down = 0;
+            k->sinceUs = 0;
+            return element(k, 3 * k->dotUs);
+        }
+        return 0;
+    }
+
+    // Silence: letter gap after 2 dots (3 nominal), word gap after 5 (7 nominal)
+    if (k->gaps == 0 && k->elements > 0 && k->sinceUs >= 2 * k->dotUs) {
+        k->gaps = 1;
+        k->elements = 0;
+        return ' ';
+    }
+    if (k->gaps == 1 && k->sinceUs >= 5 * k->dotUs) {
+        k->gaps = 2;
+        return ' ';
+    }
+    return 0;
+}
+
+uint16_t tapkey_wpm(const tapkey_t *k) {
+
+    return (uint16_t)(1200000UL / k->dotUs);
+}
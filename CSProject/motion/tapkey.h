@@ -0,0 +1,56 @@
+/*
+ * tapkey.h
+ *
+ *  Straight-key Morse input: the tag is tapped down on the table to key
+ *  down and tapped again to key up. Each tap is an acceleration impulse;
+ *  the time between them is the element, shorter than two dot lengths is
+ *  a dot, longer a dash. The dot length follows the operator (adaptive
+ *  WPM) and letter and word gaps are inferred from the silence after the
+ *  last element.
+ *
+ *  Every impact toggles the key, so one element takes two taps. Lifting
+ *  the tag off the table leaves no impulse an accelerometer can tell from
+ *  handling noise, and holding it pressed down reads the same as resting,
+ *  so release is a second tap rather than the end of the first one. A
+ *  missed second tap is closed as a dash after 7 dot lengths.
+ *
+ *  Output symbols follow the tilt gestures: '.', '-', ' ' after a letter
+ *  and a second ' ' after a word.
+ */
+
+#ifndef TAPKEY_H_
+#define TAPKEY_H_
+
+#include <stdint.h>
+
+typedef struct {
+    int16_t impactMg;     // ||a| - 1 g| that counts as a tap
+    uint16_t deadMs;      // Ringing after a tap that is ignored
+    uint16_t dotMs;       // Dot length to start from
+    uint16_t dotMinMs;    // Limits of the adaptive dot length
+    uint16_t dotMaxMs;
+} tapkey_config_t;
+
+// Starts at 8 WPM, a comfortable speed for hand tapping
+#define TAPKEY_CONFIG_DEFAULT { 400, 40, 150, 40, 400 }
+
+typedef struct {
+    const tapkey_config_t *config;
+    uint16_t periodUs;    // Sample period
+    uint8_t down;         // Key is down
+    uint32_t sinceUs;     // Time since the last tap
+    uint32_t dotUs;       // Current dot length estimate
+    uint8_t elements;     // Elements since the last letter gap
+    uint8_t gaps;         // Gap symbols emitted since the last element
+} tapkey_t;
+
+void tapkey_init(tapkey_t *k, const tapkey_config_t *config, uint16_t rate_hz);
+void tapkey_set_rate(tapkey_t *k, uint16_t rate_hz);
+
+// Feed one sample, accel in g Q16.16. Returns a Morse symbol or 0
+char tapkey_update(tapkey_t *k, const int32_t accel[3]);
+
+// Current speed estimate, PARIS standard: 1200 / dot ms
+uint16_t tapkey_wpm(const tapkey_t *k);
+
+#endif /* TAPKEY_H_ */
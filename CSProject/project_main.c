@@ -15,16 +15,19 @@
 
 /* C Standard library */
 #include <stdio.h>
-#include <math.h>
+#include <string.h>
 
 /* XDCtools files */
 #include <xdc/std.h>
 #include <xdc/runtime/System.h>
+#include <xdc/runtime/Timestamp.h>
+#include <xdc/runtime/Types.h>
 
 /* BIOS Header files */
 #include <ti/sysbios/BIOS.h>
 #include <ti/sysbios/knl/Clock.h>
 #include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Semaphore.h>
 #include <ti/drivers/PIN.h>
 #include <ti/drivers/pin/PINCC26XX.h>
 #include <ti/drivers/I2C.h>
@@ -38,6 +41,14 @@
 #include "Board.h"
 #include "sensors/opt3001.h"
 #include "sensors/mpu9250.h"
+#include "sensors/ak8963.h"
+#include "sensors/i2c_regs.h"
+#include "motion/pipeline.h"
+#include "motion/sample_ring.h"
+#include "motion/sample_timing.h"
+#include "motion/imu_trace.h"
+#include "morse/morse.h"
+#include "storage/flash_store.h"
 #include "sensors/buzzer.h"
 
 #define NOTE_C5  523
@@ -50,8 +61,6 @@
 #define NOTE_AS5 932
 #define REST     0
 
-#define PI 3.14159265
-
 /* Task */
 #define STACKSIZE 2048
 Char sensorTaskStack[STACKSIZE];
@@ -63,14 +72,49 @@ Char LEDTaskStack[STACKSIZE];
 // Definition of the state machine
 enum state { WAITING=1, DATA_READY };
 enum state OPTState = WAITING;
-enum state MPUState = WAITING;
 
 // Global variables for MPU9250 data
 float ax, ay, az, gx, gy, gz;
 float roll;
 
-// Most recent received status from sensorListener()
-char temp = NULL;
+// Orientation and Morse gestures, updated with every IMU sample; roll above is its roll in degrees.
+// The same pipeline runs on the host in imu_replay.c
+pipeline_t pipeline;
+
+// Every IMU sample with its timestamp, the UART task reads the newest one for telemetry
+sample_ring_t mpuRing;
+
+// Magnetometer in AK8963_UT_PER_LSB units, read at 100 Hz in the same task wakeup as the IMU
+int16_t mag[3];
+bool magReady = false;
+uint8_t magSlot = 0;
+
+// Tilt gesture thresholds: gestureBase is what "#gesture" tunes, gestureConfig is what the
+// pipeline uses, gestureBase scaled to the mounting calibration. The tap keyer settings are
+// for "#mode tap". Dynamic gestures are matched against templates recorded with "#record"
+gesture_config_t gestureBase = GESTURE_CONFIG_DEFAULT;
+gesture_config_t gestureConfig = GESTURE_CONFIG_DEFAULT;
+tapkey_config_t tapConfig = TAPKEY_CONFIG_DEFAULT;
+
+// New "#gesture" thresholds, filled by the UART task and installed by the sensor task between
+// samples so gesture_update() never sees half of them. A new request is refused until then
+gesture_config_t gestureRequest;
+volatile bool gestureRequestReady = false;
+
+// Template recording and match thresholds requested over UART, one entry per slot, applied by
+// the sensor task between samples so a template never changes in the middle of a match
+#define DTW_NO_REQUEST  0xFFFFFFFF
+volatile char dtwRecordRequest[DTW_MAX_TEMPLATES];                // Symbol to record, 0 for none
+volatile uint32_t dtwThresholdRequest[DTW_MAX_TEMPLATES];        // DTW_NO_REQUEST for none
+
+// Mounting calibration ("#mount"), run and persisted by the sensor task. A stored
+// calibration rotates every sample and scales gestureBase into gestureConfig at boot
+volatile bool mountCalRequest = false;
+volatile bool mountResetRequest = false;
+
+// Trace capture over UART ("#capture"), the UART is switched to CAPTURE_BAUD while it runs
+#define CAPTURE_BAUD  115200
+bool captureRequest = false;
 
 // Boolean for checking button is pressed to send SOS signal
 bool sendSOS = false;
@@ -84,6 +128,57 @@ const char SOS[15] = {'.', '.', '.', ' ', '-', '-', '-', ' ', '.', '.', '.', ' '
 // Buzzer buffer which contains the message from UART read
 char beepMorse[64];
 
+// Plain text from "#text", encoded and keyed out on the buzzer and LED by the buzzer task.
+// The UART task fills keyText and then sets keyTextReady, the buzzer task clears it when
+// done and a new text is refused until then
+#define KEY_UNIT_MS  100
+char keyText[64];
+volatile bool keyTextReady = false;
+
+// Symbols are decoded on the device, each word is sent over UART as one line of text
+morse_decoder_t morseDecoder;
+char morseWord[32];
+uint8_t morseWordLength = 0;
+
+// MPU data-ready interrupt: the pin callback stamps the time and wakes the sensor task
+static Semaphore_Struct mpuSemStruct;
+static Semaphore_Handle mpuSem;
+
+// Sampling statistics in Timestamp ticks: interval between data-ready interrupts (jitter)
+// and time from the interrupt until the sample is available to sensorListener() (latency).
+// Reset every time they are printed.
+sample_timing_t mpuTiming;
+uint32_t timestampHz = 0;
+
+// FIFO streaming mode: instead of waking on every data-ready interrupt the sensor task
+// sleeps for MPU_FIFO_BATCH sample periods and drains all frames in one I2C transfer.
+// Used automatically for profiles faster than MPU_FIFO_RATE.
+bool mpuFifoMode = false;
+#define MPU_FIFO_RATE    200
+#define MPU_FIFO_BATCH   10
+mpu9250_sample_t mpuFifoBuf[MPU_FIFO_BATCH * 2];
+uint32_t mpuFifoOverflows = 0;
+
+// MPU profile and recalibration requested over UART, applied by the sensor task between samples
+volatile mpu9250_profile_t mpuProfileRequest = MPU9250_PROFILE_GESTURE;
+volatile bool mpuCalibrateRequest = false;
+
+// Wake-on-motion standby: after mpuIdleSeconds without rotation the sensor task puts the
+// MPU into accelerometer-only cycle mode and blocks until motion above mpuWomThreshold
+// wakes it up through the INT pin
+uint16_t mpuWomThreshold = 80;  // mg
+uint16_t mpuIdleSeconds = 30;
+uint32_t mpuQuietSamples = 0;
+uint32_t mpuWakeups = 0;
+#define MPU_QUIET_DPS  10
+
+// MPU self test diagnostic: requested over UART, run by the sensor task, reported by the UART task
+volatile bool mpuSelfTestRequest = false;
+volatile bool mpuSelfTestReady = false;
+mpu9250_self_test_t mpuSelfTest;
+
+char sensorListener();
+
 // Pins RTOS-variables and configuration
 static PIN_Handle buttonHandle;
 static PIN_State buttonState;
@@ -92,9 +187,10 @@ static PIN_State ledState;
 static PIN_Handle hMpuPin;
 static PIN_State  MpuPinState;
 
-// MPU power pin
+// MPU power pin and data-ready interrupt pin (INT_PIN_CFG = 0x12: active high 50 us pulse)
 static PIN_Config MpuPinConfig[] = {
     Board_MPU_POWER  | PIN_GPIO_OUTPUT_EN | PIN_GPIO_HIGH | PIN_PUSHPULL | PIN_DRVSTR_MAX,
+    Board_MPU_INT    | PIN_INPUT_EN | PIN_PULLDOWN | PIN_IRQ_DIS,
     PIN_TERMINATE
 };
 
@@ -127,7 +223,292 @@ void buttonFxn(PIN_Handle handle, PIN_Id pinId) {
     sendSOS = true; // Send SOS signal
 }
 
+// Function for handling the MPU data-ready interrupt, wakes up the sensor task
+void mpuIntFxn(PIN_Handle handle, PIN_Id pinId) {
+    sample_timing_edge(&mpuTiming, Timestamp_get32());
+    Semaphore_post(mpuSem);
+}
+
+// Convert Timestamp ticks into microseconds, timestampHz is read once in main()
+uint32_t ticksToUs(uint32_t ticks) {
+    return sample_timing_us(ticks, timestampHz);
+}
+
+
+
+// Publish one IMU sample to the ring and run it through the gesture pipeline, all integer math
+void mpuProcess(const mpu9250_sample_t *sample, uint32_t stamp) {
+    int32_t accel[3], gyro[3];
+    imu_sample_t entry;
+
+    entry.time = stamp;
+    memcpy(entry.accel, sample->accel, sizeof(entry.accel));
+    memcpy(entry.gyro, sample->gyro, sizeof(entry.gyro));
+    sample_ring_push(&mpuRing, &entry);
+
+    mpu9250_scale_q16(sample, accel, gyro);
+    pipeline_update(&pipeline, accel, gyro);
+    roll = pipeline.orientation.roll / 1000.0f;
+}
+
+// Count samples without rotation, returns true when the MPU has been idle long enough for standby
+bool mpuIdle(const mpu9250_sample_t *sample) {
+    int16_t limit = mpu9250_dps_to_raw(MPU_QUIET_DPS);
+    int i;
+
+    for (i = 0; i < 3; i++) {
+        if (sample->gyro[i] > limit || sample->gyro[i] < -limit) {
+            mpuQuietSamples = 0;
+            return false;
+        }
+    }
+    return ++mpuQuietSamples >= (uint32_t)mpuIdleSeconds * mpu9250_sample_rate();
+}
+
+// Put the MPU into wake-on-motion standby and block until motion is detected
+void mpuStandby(I2C_Handle *i2cMPU) {
+
+    System_printf("MPU9250: standby\n");
+    System_flush();
+
+    // Drop a data-ready post from before standby only once data-ready is off and before
+    // wake on motion is armed, a motion edge in between would otherwise be lost
+    mpu9250_wom_enter(i2cMPU, mpuWomThreshold);
+    Semaphore_pend(mpuSem, BIOS_NO_WAIT);
+    mpu9250_wom_arm(i2cMPU);
+    Semaphore_pend(mpuSem, BIOS_WAIT_FOREVER);  // CPU can sleep until the INT pin fires
+    mpu9250_wom_exit(i2cMPU);
+
+    if (mpuFifoMode) {
+        mpu9250_fifo_start(i2cMPU);
+    }
+    mpuQuietSamples = 0;
+    mpuWakeups++;
+
+    System_printf("MPU9250: motion, resuming\n");
+    System_flush();
+}
+
+// Function for handling '#'-prefixed commands received over UART
+void commandHandler(UART_Handle uart, char *command) {
+    char reply[64];
+
+    // Strip the line ending
+    command[strcspn(command, "\r\n")] = '\0';
 
+    // "#capture on|off": stream raw IMU samples as binary trace records at CAPTURE_BAUD
+    if (strcmp(command, "capture on") == 0 || strcmp(command, "capture off") == 0) {
+        captureRequest = command[9] == 'n';
+        sprintf(reply, "OK %s\r\n", command);
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#text <message>": key the message out in Morse on the buzzer and LED
+    if (strncmp(command, "text ", 5) == 0 && command[5] != '\0') {
+        if (keyTextReady) {
+            sprintf(reply, "ERR text busy\r\n");
+        }
+        else {
+            // The text must be complete in memory before the buzzer task sees the flag,
+            // the same barrier the sample ring publishes its slots with
+            strncpy(keyText, command + 5, sizeof(keyText) - 1);
+            keyText[sizeof(keyText) - 1] = '\0';
+            SAMPLE_RING_BARRIER();
+            keyTextReady = true;
+            sprintf(reply, "OK text\r\n");
+        }
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#cal": re-estimate the MPU biases, keep the device still
+    if (strcmp(command, "cal") == 0) {
+        mpuCalibrateRequest = true;
+        sprintf(reply, "OK cal\r\n");
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#mount cal": learn the mounting and pose reach, "#mount reset": back to the defaults,
+    // "#mount" reports the stored calibration
+    if (strncmp(command, "mount", 5) == 0) {
+        if (strcmp(command, "mount cal") == 0) {
+            mountCalRequest = true;
+        }
+        else if (strcmp(command, "mount reset") == 0) {
+            mountResetRequest = true;
+        }
+        else if (command[5] != '\0') {
+            sprintf(reply, "ERR %s\r\n", command);
+            UART_write(uart, reply, strlen(reply));
+            return;
+        }
+        if (command[5] != '\0') {
+            sprintf(reply, "OK %s\r\n", command);
+        }
+        else if (pipeline.mount.valid) {
+            sprintf(reply, "OK mount dot %ld dash %ld deg space %d mg\r\n", (long)(pipeline.mount.dotReach / 1000),
+                    (long)(pipeline.mount.dashReach / 1000), pipeline.mount.spacePeak);
+        }
+        else {
+            sprintf(reply, "OK mount default\r\n");
+        }
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#selftest": run the MPU factory self test, result is reported when done
+    if (strcmp(command, "selftest") == 0) {
+        mpuSelfTestRequest = true;
+        sprintf(reply, "OK selftest\r\n");
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#wom <threshold mg> <idle s>": configure wake-on-motion standby. An idle time of 0 would
+    // put the MPU back into standby on the first sample after every wake, and the threshold
+    // register holds 4 to 1020 mg
+    unsigned int threshold, idle;
+    if (sscanf(command, "wom %u %u", &threshold, &idle) == 2 && threshold > 0 && threshold <= 1020
+            && idle > 0 && idle <= 0xFFFF) {
+        mpuWomThreshold = threshold;
+        mpuIdleSeconds = idle;
+        sprintf(reply, "OK wom %u mg %u s\r\n", threshold, idle);
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#gesture <enter deg> <exit deg> <dwell ms>": tune the dot/dash pose thresholds
+    unsigned int enterDeg, exitDeg, dwell;
+    if (sscanf(command, "gesture %u %u %u", &enterDeg, &exitDeg, &dwell) == 3 && exitDeg < enterDeg
+            && dwell <= 0xFFFF) {
+        if (gestureRequestReady) {
+            sprintf(reply, "ERR gesture busy\r\n");
+        }
+        else {
+            gestureRequest.rollEnter = enterDeg * 1000;
+            gestureRequest.rollExit = exitDeg * 1000;
+            gestureRequest.dwellMs = dwell;
+            SAMPLE_RING_BARRIER();
+            gestureRequestReady = true;
+            sprintf(reply, "OK gesture %u/%u deg %u ms\r\n", enterDeg, exitDeg, dwell);
+        }
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#record <slot> <symbol>": record a dynamic gesture template, starts with the next motion
+    unsigned int slot;
+    if (sscanf(command, "record %u", &slot) == 1 && slot < DTW_MAX_TEMPLATES && strlen(command) > 9) {
+        char symbol = command[strlen(command) - 1];
+        dtwRecordRequest[slot] = symbol;
+        sprintf(reply, "OK record %u '%c'\r\n", slot, symbol);
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#dtw": list the gesture templates, "#dtw <slot> <threshold>" sets a match threshold.
+    // A threshold not yet applied by the sensor task is listed as requested
+    int dtwFields = sscanf(command, "dtw %u %u", &slot, &threshold);
+    if (strncmp(command, "dtw", 3) == 0 && (command[3] == '\0' || (dtwFields == 2
+            && slot < DTW_MAX_TEMPLATES && threshold != DTW_NO_REQUEST))) {
+        if (dtwFields == 2) {
+            dtwThresholdRequest[slot] = threshold;
+        }
+        for (slot = 0; slot < DTW_MAX_TEMPLATES; slot++) {
+            const dtw_template_t *tpl = &pipeline.dtw.templates[slot];
+            uint32_t requested = dtwThresholdRequest[slot];
+            sprintf(reply, "DTW %u: '%c' %u frames threshold %lu\r\n", slot, tpl->length ? tpl->symbol : '-',
+                    tpl->length, (unsigned long)(requested != DTW_NO_REQUEST ? requested : tpl->threshold));
+            UART_write(uart, reply, strlen(reply));
+        }
+        sprintf(reply, "DTW last match %lu\r\n", (unsigned long)pipeline.dtw.lastCost);
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#mode tilt|tap": Morse input mode, "#mode" reports it with the tapping speed
+    if (strncmp(command, "mode", 4) == 0) {
+        if (strcmp(command, "mode tap") == 0) {
+            // Repeating it in tap mode is not an error and keeps the learned speed
+            pipeline_set_mode(&pipeline, PIPELINE_TAP);
+        }
+        else if (strcmp(command, "mode tilt") == 0) {
+            pipeline_set_mode(&pipeline, PIPELINE_TILT);
+        }
+        else if (command[4] != '\0') {
+            sprintf(reply, "ERR %s\r\n", command);
+            UART_write(uart, reply, strlen(reply));
+            return;
+        }
+        if (pipeline.mode == PIPELINE_TAP) {
+            sprintf(reply, "OK mode tap %u wpm\r\n", tapkey_wpm(&pipeline.tapkey));
+        }
+        else {
+            sprintf(reply, "OK mode tilt\r\n");
+        }
+        UART_write(uart, reply, strlen(reply));
+        return;
+    }
+
+    // "#i2c" / "#i2c reset": per-device bus statistics
+    if (strncmp(command, "i2c", 3) == 0) {
+        i2c_stats_t st;
+        uint8_t i;
+        for (i = 0; i2c_reg_stats(i, &st); i++) {
+            sprintf(reply, "I2C %02x: %lu tx %lu B %lu fail %lu retry", st.addr,
+                    (unsigned long)st.transactions, (unsigned long)st.bytes,
+                    (unsigned long)st.failures, (unsigned long)st.retries);
+            UART_write(uart, reply, strlen(reply));
+            if (st.transactions > 0) {
+                sprintf(reply, " %lu/%lu/%lu us\r\n", (unsigned long)ticksToUs(st.minTime),
+                        (unsigned long)ticksToUs((uint32_t)(st.totalTime / st.transactions)),
+                        (unsigned long)ticksToUs(st.maxTime));
+            }
+            else {
+                sprintf(reply, "\r\n");
+            }
+            UART_write(uart, reply, strlen(reply));
+        }
+        if (strcmp(command, "i2c reset") == 0) {
+            i2c_reg_stats_reset();
+        }
+        return;
+    }
+
+    // "#profile <name>": switch the MPU rate/filter/full-scale profile
+    if (strncmp(command, "profile ", 8) == 0) {
+        mpu9250_profile_t p;
+        for (p = MPU9250_PROFILE_GESTURE; p < MPU9250_PROFILE_COUNT; p++) {
+            if (strcmp(command + 8, mpu9250_profile_name(p)) == 0) {
+                mpuProfileRequest = p;
+                sprintf(reply, "OK profile %s\r\n", mpu9250_profile_name(p));
+                UART_write(uart, reply, strlen(reply));
+                return;
+            }
+        }
+    }
+
+    sprintf(reply, "ERR %s\r\n", command);
+    UART_write(uart, reply, strlen(reply));
+}
+
+// Decode one Morse symbol, the word is written out when it ends or the buffer is full
+void morseSend(UART_Handle uart, char symbol) {
+    char c = morse_decoder_feed(&morseDecoder, symbol);
+
+    // Accented letters and prosigns are spelled out, "<SK>" or the letter in UTF-8
+    if (c != 0 && c != ' ') {
+        morseWordLength += morse_spell(c, morseWord + morseWordLength);
+    }
+    if ((c == ' ' && morseWordLength > 0) || morseWordLength > sizeof(morseWord) - 2 - MORSE_SPELL_MAX) {
+        morseWord[morseWordLength++] = '\r';
+        morseWord[morseWordLength++] = '\n';
+        UART_write(uart, morseWord, morseWordLength);
+        morseWordLength = 0;
+    }
+}
 
 /* Task Functions */
 Void uartTaskFxn(UArg arg0, UArg arg1) {
@@ -153,68 +534,184 @@ Void uartTaskFxn(UArg arg0, UArg arg1) {
        System_abort("Error opening the UART");
     }
 
+    // Trace capture state, every IMU sample is read from the ring while capturing
+    bool capturing = false;
+    sample_reader_t captureReader;
+    uint32_t captureStamp = 0;
+    bool captureStarted = false;
+    uint16_t captureRate = 0;
+
+    // Last mounting calibration step prompted
+    mount_cal_step_t mountStep = MOUNT_CAL_IDLE;
+
     char morseLetter = NULL; // Last value received from MPU sensor
-    char SOSchecker = NULL; // Last sent character
     char message[64]; // UART read buffer
 
+    morse_decoder_init(&morseDecoder);
+
+    // Telemetry only needs the newest IMU sample every loop
+    sample_reader_t telemetryReader;
+    imu_sample_t latest;
+    sample_reader_init(&telemetryReader, &mpuRing);
+
     while (1) {
         // UART read for reading messages
-        uint8_t bytesRead = UART_read(uart, message, sizeof(message)); // Read into the buffer, leaving space for null terminator
+        uint8_t bytesRead = UART_read(uart, message, sizeof(message) - 1); // Read into the buffer, leaving space for null terminator
         if (bytesRead > 0) {
-            strcpy(beepMorse, message);
+            message[bytesRead] = '\0';
+            if (message[0] == '#') {
+                commandHandler(uart, message + 1);
+            }
+            else {
+                strcpy(beepMorse, message);
+            }
             memset(message, 0, sizeof(message));
         }
 
 
-        // sendSOS: First checks if it is needed to put spaces before the SOS signal,
-        //    then use UART to send SOS signal
-        if(sendSOS) {
-            if(SOSchecker == '.' || SOSchecker == '-') {
-                char space[10];
-                sprintf(space, "%c\r\n\0", ' ');
-                UART_write(uart, space ,strlen(space) + 1);
-                UART_write(uart, space ,strlen(space) + 1);
-                SOSchecker = NULL;
+        // Report a finished self test, one line with the deviation and verdict per axis
+        if (mpuSelfTestReady) {
+            const char *axes[6] = { "ax", "ay", "az", "gx", "gy", "gz" };
+            char line[200];
+            int i, len = sprintf(line, "SELFTEST");
+            for (i = 0; i < 6; i++) {
+                len += sprintf(line + len, " %s=%.1f%%:%s", axes[i], mpuSelfTest.deviation[i],
+                        mpuSelfTest.pass[i] ? "PASS" : "FAIL");
             }
+            sprintf(line + len, "\r\n");
+            UART_write(uart, line, strlen(line));
+            mpuSelfTestReady = false;
+        }
+
+        // Prompt each mounting calibration step as the sensor task reaches it
+        if (!capturing && pipeline.mountCal.step != mountStep) {
+            char line[80];
+            mountStep = pipeline.mountCal.step;
+            if (mountStep == MOUNT_CAL_DONE) {
+                sprintf(line, "MOUNT done: dot %ld dash %ld deg space %d mg\r\n",
+                        (long)(pipeline.mountCal.result.dotReach / 1000),
+                        (long)(pipeline.mountCal.result.dashReach / 1000), pipeline.mountCal.result.spacePeak);
+            }
+            else {
+                sprintf(line, "MOUNT %s\r\n", mount_cal_step_name(mountStep));
+            }
+            UART_write(uart, line, strlen(line));
+        }
+
+        // sendSOS: First ends the letter and word being keyed,
+        //    then sends the SOS signal through the decoder
+        if(sendSOS) {
+            morseSend(uart, ' ');
+            morseSend(uart, ' ');
 
             int i;
-            char str0[10];
             for (i = 0; i < strlen(SOS); i++) {
-                sprintf(str0, "%c\r\n\0", SOS[i]);
-                UART_write(uart, str0, strlen(str0) +1);
+                morseSend(uart, SOS[i]);
             }
 
             Task_sleep(500000 / Clock_tickPeriod);
             sendSOS = false;
         }
 
-        // Send sensor data as a string with UART if the state is DATA_READY
-        if (MPUState == DATA_READY) {
-            char str[200];
-            char str1[10];
+        // Start or stop a trace capture: the UART is reopened for binary output at the capture rate
+        if (captureRequest != capturing) {
+            UART_close(uart);
+            capturing = captureRequest;
+            uartParams.baudRate = capturing ? CAPTURE_BAUD : 9600;
+            uartParams.writeDataMode = capturing ? UART_DATA_BINARY : UART_DATA_TEXT;
+            uart = UART_open(Board_UART0, &uartParams);
+            if (uart == NULL) {
+               System_abort("Error opening the UART");
+            }
+            sample_reader_init(&captureReader, &mpuRing);
+            captureStarted = false;
+            captureRate = 0;
+        }
 
-            morseLetter = sensorListener();
-            if(morseLetter != temp) {
-                if(morseLetter) {
-                    sprintf(str1, "%c\r\n\0", morseLetter);
-                    UART_write(uart, str1, strlen(str1) +1);
-                    SOSchecker = morseLetter;
+        // Stream every new sample as trace records, with a header first and after a profile change
+        if (capturing) {
+            uint8_t trace[IMU_TRACE_RECORD_SIZE * 16];
+            imu_sample_t sample;
+            int len = 0;
+
+            if (captureRate != mpu9250_sample_rate()) {
+                imu_trace_header_t header;
+                header.version = IMU_TRACE_VERSION;
+                header.rate = captureRate = mpu9250_sample_rate();
+                mpu9250_get_scale(&header.ascale, &header.gscale);
+                len = imu_trace_write_header(trace, &header);
+                UART_write(uart, trace, len);
+                len = 0;
+            }
+            while (sample_reader_next(&captureReader, &sample)) {
+                imu_trace_record_t record;
+                uint32_t dt;
+
+                // The first record has no predecessor, its interval is 0
+                if (!captureStarted) {
+                    captureStamp = sample.time;
+                    captureStarted = true;
                 }
-                temp = morseLetter;
+                dt = ticksToUs(sample.time - captureStamp);
+
+                // seq is the ring index so lost samples show up as gaps on the host
+                record.seq = (uint8_t)(captureReader.cursor - 1);
+                record.dtUs = dt > 0xFFFF ? 0xFFFF : dt;
+                memcpy(record.accel, sample.accel, sizeof(record.accel));
+                memcpy(record.gyro, sample.gyro, sizeof(record.gyro));
+                captureStamp = sample.time;
+
+                len += imu_trace_write_record(trace + len, &record);
+                if (len + IMU_TRACE_RECORD_SIZE > sizeof(trace)) {
+                    UART_write(uart, trace, len);
+                    len = 0;
+                }
+            }
+            if (len > 0) {
+                UART_write(uart, trace, len);
             }
+        }
+
+        // Decode every Morse symbol the gesture state machine has queued, the UART
+        // carries only trace records while capturing
+        while (!capturing && (morseLetter = sensorListener()) != NULL) {
+            morseSend(uart, morseLetter);
+        }
+
+        // Send the newest sensor sample as a string with UART if one arrived since the last loop
+        if (sample_reader_latest(&telemetryReader, &latest)) {
+            char str[300];
+            mpu9250_sample_t sample;
+
+            memcpy(sample.accel, latest.accel, sizeof(sample.accel));
+            memcpy(sample.gyro, latest.gyro, sizeof(sample.gyro));
+            mpu9250_scale(&sample, &ax, &ay, &az, &gx, &gy, &gz);
 
-            sprintf(str, "\nRoll: %.2f degrees\n"
+            sprintf(str, "\nRoll: %.2f degrees, pitch: %.2f degrees, yaw: %.2f degrees\n"
                     "Gyroscope: gx=%.2f dps, gy=%.2f dps, gz=%.2f dps\n "
-                    "Accelerometer: ax=%.2f m/s^2, ay=%.2f m/s^2, az=%.2f m/s^2\n",
-                    roll, gx, gy, gz, ax, ay, az);
+                    "Accelerometer: ax=%.2f m/s^2, ay=%.2f m/s^2, az=%.2f m/s^2\n"
+                    "Magnetometer: mx=%.1f uT, my=%.1f uT, mz=%.1f uT\n",
+                    roll, pipeline.orientation.pitch / 1000.0f, pipeline.orientation.yaw / 1000.0f, gx, gy, gz, ax, ay, az,
+                    mag[0] * AK8963_UT_PER_LSB, mag[1] * AK8963_UT_PER_LSB, mag[2] * AK8963_UT_PER_LSB);
             System_printf("%s\n", str);
+            if (mpuFifoMode) {
+                System_printf("MPU: FIFO %u samples, %u overflows\n", mpuTiming.samples, mpuFifoOverflows);
+                sample_timing_reset(&mpuTiming);
+            }
+            else if (mpuTiming.samples > mpuTiming.timeouts) {
+                // Samples read after a timeout have no edge and no latency
+                System_printf("MPU: %u samples, %u timeouts, period %u-%u us, latency avg %u us max %u us\n",
+                        mpuTiming.samples, mpuTiming.timeouts, ticksToUs(mpuTiming.periodMin),
+                        ticksToUs(mpuTiming.periodMax),
+                        ticksToUs(mpuTiming.latencySum / (mpuTiming.samples - mpuTiming.timeouts)),
+                        ticksToUs(mpuTiming.latencyMax));
+                sample_timing_reset(&mpuTiming);
+            }
             System_flush();
-
-            MPUState = WAITING;
         }
 
-        // 500 milisecond sleep
-        Task_sleep(500000 / Clock_tickPeriod);
+        // 500 milisecond sleep, 50 ms while capturing so the sample ring does not overflow
+        Task_sleep((capturing ? 50000 : 500000) / Clock_tickPeriod);
     }
 }
 
@@ -294,6 +791,29 @@ Void buzzerFxn(UArg arg0, UArg arg1) {
                 beepMorse[i] = '\0';
             }
         }
+
+        // Key out "#text" one event at a time, the tone and the LED follow the key
+        if (keyTextReady) {
+            morse_encoder_t encoder;
+            morse_event_t event;
+
+            morse_encoder_init(&encoder);
+            morse_encoder_input(&encoder, keyText, strlen(keyText));
+            while (morse_encoder_next(&encoder, &event)) {
+                if (event.on) {
+                    buzzerOpen(hBuzzer);
+                    buzzerSetFrequency(1000);
+                    PIN_setOutputValue(ledHandle, Board_LED0, 1);
+                }
+                Task_sleep(event.units * KEY_UNIT_MS * 1000 / Clock_tickPeriod);
+                if (event.on) {
+                    buzzerSetFrequency(0);
+                    buzzerClose();
+                    PIN_setOutputValue(ledHandle, Board_LED0, 0);
+                }
+            }
+            keyTextReady = false;
+        }
     }
 }
 
@@ -324,32 +844,175 @@ Void mpuSensorTaskFxn(UArg arg0, UArg arg1) {
     // Setup the MPU9250 sensor for use
     Task_sleep(20000 / Clock_tickPeriod);
     mpu9250_setup(&i2cMPU);
+    magReady = ak8963_setup(&i2cMPU);
+    pipeline_init(&pipeline, &gestureConfig, &tapConfig, mpu9250_sample_rate());
+
+    // Restore the mounting calibration, the thresholds follow the stored reach
+    mount_t mount;
+    mount_cal_step_t mountStep = MOUNT_CAL_IDLE;
+    if (flash_store_read(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION, &mount, sizeof(mount)) == FLASH_STORE_OK
+            && mount.valid) {
+        pipeline_set_mount(&pipeline, &mount);
+        mount_gesture_config(&mount, &gestureBase, &gestureConfig);
+        System_printf("MPU9250: mount calibration loaded\n");
+        System_flush();
+    }
+
+    // Sensor is configured, start listening to the data-ready interrupt
+    PIN_setInterrupt(hMpuPin, Board_MPU_INT | PIN_IRQ_POSEDGE);
+
+    mpu9250_sample_t sample;
 
     while (1) {
-        // Save the sensor value into the global variable and edit state
-        if (MPUState == WAITING) {
-            mpu9250_get_data(&i2cMPU, &ax, &ay, &az, &gx, &gy, &gz);
-            roll = atan2(ay, az) * 180.0 / PI;
-            MPUState = DATA_READY;
+        // Refresh the calibration on request or when the at-rest gyro shows drift
+        if (mpuCalibrateRequest) {
+            System_printf("MPU9250: Calibrating...\n");
+            System_flush();
+            mpu9250_calibrate(&i2cMPU);
+            if (mpuFifoMode) {
+                mpu9250_fifo_start(&i2cMPU);
+            }
+            mpuCalibrateRequest = false;
         }
 
-        // The sensor receive data 20 times per second
-        Task_sleep(50000 / Clock_tickPeriod);
+        // Mounting calibration: start the guided sequence or go back to the sensor frame
+        if (mountCalRequest) {
+            pipeline_calibrate_mount(&pipeline);
+            mountCalRequest = false;
+        }
+        if (mountResetRequest) {
+            pipeline_set_mount(&pipeline, NULL);
+            gestureConfig = gestureBase;
+            flash_store_write(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION, &pipeline.mount, sizeof(pipeline.mount));
+            mountResetRequest = false;
+        }
+
+        // The pipeline installs a finished calibration itself, store it once and scale the thresholds
+        if (pipeline.mountCal.step != mountStep) {
+            mountStep = pipeline.mountCal.step;
+            if (mountStep == MOUNT_CAL_DONE) {
+                mount_gesture_config(&pipeline.mount, &gestureBase, &gestureConfig);
+                if (flash_store_write(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION, &pipeline.mount,
+                        sizeof(pipeline.mount)) != FLASH_STORE_OK) {
+                    System_printf("MPU9250: Saving mount calibration FAILED\n");
+                    System_flush();
+                }
+            }
+        }
+
+        // New tilt thresholds, scaled to the mounting. The whole config changes between two samples
+        if (gestureRequestReady) {
+            gesture_config_t config;
+            gestureBase.rollEnter = gestureRequest.rollEnter;
+            gestureBase.rollExit = gestureRequest.rollExit;
+            gestureBase.dwellMs = gestureRequest.dwellMs;
+            mount_gesture_config(&pipeline.mount, &gestureBase, &config);
+            gestureConfig = config;
+            gestureRequestReady = false;
+        }
+
+        // Gesture templates: arm a recording or set a match threshold
+        uint8_t slot;
+        for (slot = 0; slot < DTW_MAX_TEMPLATES; slot++) {
+            if (dtwRecordRequest[slot] != 0) {
+                dtw_record(&pipeline.dtw, slot, dtwRecordRequest[slot]);
+                dtwRecordRequest[slot] = 0;
+            }
+            if (dtwThresholdRequest[slot] != DTW_NO_REQUEST) {
+                pipeline.dtw.templates[slot].threshold = dtwThresholdRequest[slot];
+                dtwThresholdRequest[slot] = DTW_NO_REQUEST;
+            }
+        }
+
+        if (mpuSelfTestRequest) {
+            mpu9250_self_test(&i2cMPU, &mpuSelfTest);
+            mpuSelfTestRequest = false;
+            mpuSelfTestReady = true;
+        }
+
+        // Switch profile between samples, fast profiles are streamed through the FIFO
+        if (mpuProfileRequest != mpu9250_get_profile()) {
+            if (mpuFifoMode) {
+                mpu9250_fifo_stop(&i2cMPU);
+            }
+            mpu9250_set_profile(&i2cMPU, mpuProfileRequest);
+            pipeline_set_rate(&pipeline, mpu9250_sample_rate());
+            mpuFifoMode = mpu9250_sample_rate() > MPU_FIFO_RATE;
+            if (mpuFifoMode) {
+                mpu9250_fifo_start(&i2cMPU);
+            }
+            System_printf("MPU9250: profile %s, %u Hz\n",
+                    mpu9250_profile_name(mpu9250_get_profile()), mpu9250_sample_rate());
+            System_flush();
+        }
+
+        if (mpuFifoMode) {
+            // Let the FIFO collect a batch of samples, then drain them at once
+            Task_sleep(MPU_FIFO_BATCH * (1000000 / mpu9250_sample_rate()) / Clock_tickPeriod);
+
+            int frames = mpu9250_read_fifo(&i2cMPU, mpuFifoBuf, MPU_FIFO_BATCH * 2);
+            if (frames == MPU9250_FIFO_OVERFLOW) {
+                mpuFifoOverflows++;
+                continue;
+            }
+
+            // Frames are spaced one sample period apart and the last one is the newest
+            int i;
+            bool idle = false;
+            uint32_t now = Timestamp_get32();
+            uint32_t period = timestampHz / mpu9250_sample_rate();
+            for (i = 0; i < frames; i++) {
+                mpuProcess(&mpuFifoBuf[i], now - (frames - 1 - i) * period);
+                if (mpu9250_bias_drifted(&mpuFifoBuf[i])) {
+                    mpuCalibrateRequest = true;
+                }
+                idle = mpuIdle(&mpuFifoBuf[i]);
+                mpuTiming.samples++;
+            }
+            if (magReady) {
+                ak8963_get_data_raw(&i2cMPU, mag);
+            }
+            if (idle) {
+                mpuStandby(&i2cMPU);
+            }
+            continue;
+        }
+
+        // Sleep until the MPU has a new sample. The timeout keeps sampling
+        // alive if an interrupt edge is ever lost.
+        bool timedOut = !Semaphore_pend(mpuSem, 100000 / Clock_tickPeriod);
+
+        // Save the sensor value into the global variable and edit state. Without an edge
+        // the sample is stamped when read, the last edge belongs to the previous sample
+        uint32_t stamp = timedOut ? Timestamp_get32() : mpuTiming.stamp;
+        mpu9250_get_data_raw(&i2cMPU, &sample);
+        mpuProcess(&sample, stamp);
+
+        // The magnetometer runs at 100 Hz, read it right after the IMU on every n-th sample
+        if (magReady && ++magSlot >= mpu9250_sample_rate() / AK8963_RATE) {
+            ak8963_get_data_raw(&i2cMPU, mag);
+            magSlot = 0;
+        }
+        if (mpu9250_bias_drifted(&sample)) {
+            mpuCalibrateRequest = true;
+        }
+
+        if (timedOut) {
+            sample_timing_timeout(&mpuTiming);
+        }
+        else {
+            sample_timing_sample(&mpuTiming, stamp, Timestamp_get32());
+        }
+
+        if (mpuIdle(&sample)) {
+            mpuStandby(&i2cMPU);
+        }
     }
 }
 
-// Function for returning morse character when condition met using sensor data
+// Function for returning the next morse character recognized from the sensor data, NULL if none
 char sensorListener() {
-    if(roll > 60 && roll < 120) {
-        return '-';
-    }
-    if(roll < -60 && roll > -120) {
-        return '.';
-    }
-    if(az > 1.25 || az < -1.25) {
-        return ' ';
-    }
-    return NULL;
+    return pipeline_pop(&pipeline);
 }
 
 // LED task function for blinking a received list of characters
@@ -416,6 +1079,33 @@ Int main(void) {
         System_abort("Pin open failed!");
     }
 
+    // Register the MPU data-ready interrupt handler, the interrupt is enabled after sensor setup
+    if (PIN_registerIntCb(hMpuPin, &mpuIntFxn) != 0) {
+        System_abort("Error registering MPU callback function");
+    }
+
+    // Semaphore for waking the MPU task on data-ready
+    Semaphore_Params mpuSemParams;
+    Semaphore_Params_init(&mpuSemParams);
+    mpuSemParams.mode = Semaphore_Mode_BINARY;
+    Semaphore_construct(&mpuSemStruct, 0, &mpuSemParams);
+    mpuSem = Semaphore_handle(&mpuSemStruct);
+
+    // Interrupt statistics, and the Timestamp frequency for converting ticks to microseconds
+    Types_FreqHz freq;
+    Timestamp_getFreq(&freq);
+    timestampHz = freq.lo;
+    sample_timing_init(&mpuTiming);
+
+    // Ring the MPU task publishes its samples into, created before any reader attaches
+    sample_ring_init(&mpuRing);
+
+    // No gesture template changes pending
+    int slot;
+    for (slot = 0; slot < DTW_MAX_TEMPLATES; slot++) {
+        dtwThresholdRequest[slot] = DTW_NO_REQUEST;
+    }
+
     // Initialize the button in the program
     buttonHandle = PIN_open(&buttonState, buttonConfig);
     if (!buttonHandle) {
@@ -0,0 +1,111 @@
+/*
+ * ak8963.c
+ *
+ *  AK8963 magnetometer driver, see ak8963.h
+ */
+
+#include <inttypes.h>
+
+#include <xdc/runtime/System.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Clock.h>
+
+#include "Board.h"
+#include "sensors/ak8963.h"
+#include "sensors/i2c_regs.h"
+
+#define AK8963_WIA    0x00  // Device id, reads 0x48
+#define AK8963_ST1    0x02  // Bit 0 data ready
+#define AK8963_HXL    0x03  // Measurement data, little endian x, y, z
+#define AK8963_ST2    0x09  // Bit 3 magnetic sensor overflow, reading it ends the measurement
+#define AK8963_CNTL1  0x0A  // Bit 4 output width, bits 3:0 mode
+#define AK8963_ASAX   0x10  // Fuse ROM sensitivity adjustment x, y, z
+
+#define AK8963_MODE_POWER_DOWN   0x00
+#define AK8963_MODE_FUSE_ROM     0x0F
+#define AK8963_MODE_CONTINUOUS2  0x16  // 16-bit output, 100 Hz
+
+// Sensitivity adjustment + 128, so that adjusted = raw * asa >> 8
+static uint16_t asa[3] = {256, 256, 256};
+static bool present = false;
+
+static bool writeReg(I2C_Handle i2c, uint8_t reg, uint8_t data) {
+
+	return i2c_reg_write(i2c, Board_MPU9250_MAG_ADDR, reg, data);
+}
+
+static bool readRegs(I2C_Handle i2c, uint8_t reg, uint8_t count, uint8_t *data) {
+
+	return i2c_reg_read(i2c, Board_MPU9250_MAG_ADDR, reg, count, data);
+}
+
+bool ak8963_setup(I2C_Handle *i2c) {
+
+	uint8_t data[3];
+	uint8_t i;
+
+	if (!readRegs(*i2c, AK8963_WIA, 1, data) || data[0] != 0x48) {
+		System_printf("AK8963: not found\n");
+		System_flush();
+		return false;
+	}
+
+	// Mode changes need 100 us in power down between them, one millisecond sleep is plenty
+	writeReg(*i2c, AK8963_CNTL1, AK8963_MODE_POWER_DOWN);
+	Task_sleep(1000 / Clock_tickPeriod);
+	writeReg(*i2c, AK8963_CNTL1, AK8963_MODE_FUSE_ROM);
+	Task_sleep(1000 / Clock_tickPeriod);
+
+	// Read the factory sensitivity adjustment, Hadj = H * ((ASA - 128) / 256 + 1)
+	readRegs(*i2c, AK8963_ASAX, 3, data);
+	for (i = 0; i < 3; i++) {
+		asa[i] = (uint16_t)data[i] + 128;
+	}
+
+	writeReg(*i2c, AK8963_CNTL1, AK8963_MODE_POWER_DOWN);
+	Task_sleep(1000 / Clock_tickPeriod);
+	writeReg(*i2c, AK8963_CNTL1, AK8963_MODE_CONTINUOUS2);
+	present = true;
+
+	System_printf("AK8963: Setup OK\n");
+	System_flush();
+	return true;
+}
+
+void ak8963_sleep(I2C_Handle *i2c) {
+
+	if (present) {
+		writeReg(*i2c, AK8963_CNTL1, AK8963_MODE_POWER_DOWN);
+	}
+}
+
+// Standby lasts far longer than the 100 us a mode change needs after power down
+void ak8963_wake(I2C_Handle *i2c) {
+
+	if (present) {
+		writeReg(*i2c, AK8963_CNTL1, AK8963_MODE_CONTINUOUS2);
+	}
+}
+
+bool ak8963_get_data_raw(I2C_Handle *i2c, int16_t mag[3]) {
+
+	uint8_t rawData[8]; // ST1, HXL..HZH, ST2
+	uint8_t i;
+
+	// One transfer from ST1 through ST2 reads the status, the data and releases the data registers
+	if (!readRegs(*i2c, AK8963_ST1, sizeof(rawData), rawData)) {
+		return false;
+	}
+	if (!(rawData[0] & 0x01) || (rawData[7] & 0x08)) {
+		return false;
+	}
+
+	for (i = 0; i < 3; i++) {
+		int32_t h = (int16_t)(((uint16_t)rawData[2 + 2 * i] << 8) | rawData[1 + 2 * i]);
+		h = (h * asa[i]) >> 8;
+		if (h > INT16_MAX) h = INT16_MAX;
+		if (h < INT16_MIN) h = INT16_MIN;
+		mag[i] = (int16_t)h;
+	}
+	return true;
+}
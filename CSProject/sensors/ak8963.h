@@ -0,0 +1,33 @@
+/*
+ * ak8963.h
+ *
+ *  AK8963 magnetometer inside the MPU9250 package, reached directly on the
+ *  sensor I2C bus through the MPU9250 bypass (INT_PIN_CFG BYPASS_EN).
+ *  Call after mpu9250_setup().
+ *
+ *  Datasheet: https://www.akm.com/content/dam/documents/products/electronic-compass/ak8963c/ak8963c-en-datasheet.pdf
+ */
+
+#ifndef AK8963_H_
+#define AK8963_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/I2C.h>
+
+#define AK8963_RATE        100   // Continuous measurement mode 2
+#define AK8963_UT_PER_LSB  0.15f // 16-bit output
+
+bool ak8963_setup(I2C_Handle *i2c);
+
+// Burst read of one measurement with the factory sensitivity adjustment applied,
+// in AK8963_UT_PER_LSB units. Returns false when there is no new data or the
+// sensor overflowed, mag is left untouched then.
+bool ak8963_get_data_raw(I2C_Handle *i2c, int16_t mag[3]);
+
+// Power down for standby and back to continuous measurement. Nothing is written
+// when ak8963_setup() did not find the sensor
+void ak8963_sleep(I2C_Handle *i2c);
+void ak8963_wake(I2C_Handle *i2c);
+
+#endif /* AK8963_H_ */
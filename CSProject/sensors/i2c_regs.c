@@ -0,0 +1,153 @@
+/*
+ * i2c_regs.c
+ *
+ *  Register access helpers, see i2c_regs.h. Nothing is printed on the transfer
+ *  path, failures and timing are only counted and read with i2c_reg_stats().
+ */
+
+#include <string.h>
+
+#include <xdc/runtime/Timestamp.h>
+#include <ti/sysbios/knl/Task.h>
+#include <ti/sysbios/knl/Clock.h>
+
+#include "sensors/i2c_regs.h"
+
+#define I2C_REG_BURST_MAX  16
+
+static i2c_stats_t stats[I2C_REG_MAX_DEVICES];
+static uint8_t deviceCount = 0;
+
+// Statistics block of a device, allocated on its first transfer. Devices past
+// I2C_REG_MAX_DEVICES share the last block.
+static i2c_stats_t *deviceStats(uint8_t addr) {
+
+	uint8_t i;
+
+	for (i = 0; i < deviceCount; i++) {
+		if (stats[i].addr == addr) {
+			return &stats[i];
+		}
+	}
+	if (deviceCount == I2C_REG_MAX_DEVICES) {
+		return &stats[I2C_REG_MAX_DEVICES - 1];
+	}
+	stats[deviceCount].addr = addr;
+	stats[deviceCount].minTime = UINT32_MAX;
+	return &stats[deviceCount++];
+}
+
+static bool transfer(I2C_Handle i2c, uint8_t addr, uint8_t *tx, uint8_t txCount, uint8_t *rx, uint16_t rxCount) {
+
+	I2C_Transaction i2cTransaction;
+	UInt key = Task_disable();
+	i2c_stats_t *s = deviceStats(addr);
+	uint8_t attempt;
+	bool ok = false;
+
+	Task_restore(key);
+
+	i2cTransaction.slaveAddress = addr;
+	i2cTransaction.writeBuf = tx;
+	i2cTransaction.writeCount = txCount;
+	i2cTransaction.readBuf = rx;
+	i2cTransaction.readCount = rxCount;
+
+	for (attempt = 0; attempt <= I2C_REG_RETRIES && !ok; attempt++) {
+		uint32_t start = Timestamp_get32();
+		ok = I2C_transfer(i2c, &i2cTransaction);
+		uint32_t time = Timestamp_get32() - start;
+
+		// The UART task copies and resets the block, it must not preempt an update
+		key = Task_disable();
+		s->transactions++;
+		s->totalTime += time;
+		if (time < s->minTime) s->minTime = time;
+		if (time > s->maxTime) s->maxTime = time;
+		if (attempt > 0) s->retries++;
+		if (ok || attempt == I2C_REG_RETRIES) {
+			s->bytes += txCount + rxCount;
+			if (!ok) s->failures++;
+		}
+		Task_restore(key);
+	}
+	return ok;
+}
+
+bool i2c_reg_stats(uint8_t index, i2c_stats_t *copy) {
+
+	UInt key = Task_disable();
+	bool found = index < deviceCount;
+
+	if (found) {
+		*copy = stats[index];
+	}
+	Task_restore(key);
+	return found;
+}
+
+void i2c_reg_stats_reset(void) {
+
+	UInt key = Task_disable();
+	uint8_t i;
+
+	for (i = 0; i < deviceCount; i++) {
+		uint8_t addr = stats[i].addr;
+		memset(&stats[i], 0, sizeof(stats[i]));
+		stats[i].addr = addr;
+		stats[i].minTime = UINT32_MAX;
+	}
+	Task_restore(key);
+}
+
+bool i2c_reg_write(I2C_Handle i2c, uint8_t addr, uint8_t reg, uint8_t value) {
+
+	uint8_t txBuffer[2];
+
+	txBuffer[0] = reg;
+	txBuffer[1] = value;
+	return transfer(i2c, addr, txBuffer, 2, NULL, 0);
+}
+
+bool i2c_reg_write_burst(I2C_Handle i2c, uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t count) {
+
+	uint8_t txBuffer[I2C_REG_BURST_MAX + 1];
+
+	if (count > I2C_REG_BURST_MAX) {
+		return false;
+	}
+	txBuffer[0] = reg;
+	memcpy(&txBuffer[1], data, count);
+	return transfer(i2c, addr, txBuffer, count + 1, NULL, 0);
+}
+
+bool i2c_reg_read(I2C_Handle i2c, uint8_t addr, uint8_t reg, uint16_t count, uint8_t *data) {
+
+	return transfer(i2c, addr, &reg, 1, data, count);
+}
+
+bool i2c_reg_apply(I2C_Handle i2c, uint8_t addr, const i2c_reg_op_t *ops, uint8_t count) {
+
+	bool ok = true;
+	uint8_t i;
+
+	for (i = 0; i < count; i++) {
+		uint8_t value = ops[i].value;
+
+		if (ops[i].mask != I2C_REG_ALL) {
+			uint8_t current;
+			if (!i2c_reg_read(i2c, addr, ops[i].reg, 1, &current)) {
+				ok = false;
+				continue;
+			}
+			value = (current & ~ops[i].mask) | (value & ops[i].mask);
+		}
+
+		ok = i2c_reg_write(i2c, addr, ops[i].reg, value) && ok;
+
+		if (ops[i].delay) {
+			Task_sleep(ops[i].delay * 1000 / Clock_tickPeriod);
+		}
+	}
+	return ok;
+}
@@ -0,0 +1,57 @@
+/*
+ * i2c_regs.h
+ *
+ *  Register access helpers shared by the sensor drivers, and an engine that
+ *  applies a const table of register writes so init sequences read as data.
+ *  Every transfer is counted in a per-device statistics block.
+ */
+
+#ifndef I2C_REGS_H_
+#define I2C_REGS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <ti/drivers/I2C.h>
+
+// One step of a register programming sequence
+typedef struct {
+    uint8_t reg;
+    uint8_t value;
+    uint8_t mask;   // Bits to change: I2C_REG_ALL writes value as is, anything else is a read-modify-write
+    uint8_t delay;  // Milliseconds to wait after the write
+} i2c_reg_op_t;
+
+#define I2C_REG_ALL  0xFF
+
+// Bus health counters of one device, times in Timestamp ticks
+typedef struct {
+    uint8_t addr;
+    uint32_t transactions;
+    uint32_t bytes;         // Written and read, register address included
+    uint32_t failures;      // Transactions that failed after all retries
+    uint32_t retries;
+    uint32_t minTime;
+    uint32_t maxTime;
+    uint64_t totalTime;
+} i2c_stats_t;
+
+#define I2C_REG_RETRIES      1
+#define I2C_REG_MAX_DEVICES  4
+
+bool i2c_reg_write(I2C_Handle i2c, uint8_t addr, uint8_t reg, uint8_t value);
+bool i2c_reg_write_burst(I2C_Handle i2c, uint8_t addr, uint8_t reg, const uint8_t *data, uint8_t count);
+bool i2c_reg_read(I2C_Handle i2c, uint8_t addr, uint8_t reg, uint16_t count, uint8_t *data);
+
+// Apply count steps in order. Returns false if any transfer failed, the
+// remaining steps are still applied.
+bool i2c_reg_apply(I2C_Handle i2c, uint8_t addr, const i2c_reg_op_t *ops, uint8_t count);
+
+// Copy the statistics of the index-th device seen on the bus, false past the
+// last one. Transfers run in task context, so the copy and the reset are
+// taken with the scheduler locked and never see a half-updated block.
+bool i2c_reg_stats(uint8_t index, i2c_stats_t *copy);
+void i2c_reg_stats_reset(void);
+
+#define I2C_REG_TABLE_SIZE(table)  (sizeof(table) / sizeof((table)[0]))
+
+#endif /* I2C_REGS_H_ */
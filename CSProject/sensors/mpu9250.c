@@ -12,12 +12,17 @@
 #include <math.h>
 
 #include <xdc/runtime/System.h>
+#include <xdc/runtime/Timestamp.h>
+#include <xdc/runtime/Types.h>
 #include <ti/sysbios/knl/Task.h>
 #include <ti/drivers/I2C.h>
 #include <ti/sysbios/knl/Clock.h>
 
 #include "Board.h"
 #include "mpu9250.h"
+#include "sensors/ak8963.h"
+#include "sensors/i2c_regs.h"
+#include "storage/flash_store.h"
 
 #define PI	3.14159265
 
@@ -32,12 +37,16 @@
 #define GYRO_CONFIG      0x1B
 #define ACCEL_CONFIG     0x1C
 #define ACCEL_CONFIG2    0x1D
+#define LP_ACCEL_ODR     0x1E
+#define WOM_THR          0x1F
 #define FIFO_EN          0x23
 #define I2C_MST_CTRL     0x24
 #define INT_PIN_CFG      0x37
 #define INT_ENABLE       0x38
+#define INT_STATUS       0x3A
 #define ACCEL_XOUT_H     0x3B
 #define GYRO_XOUT_H      0x43
+#define MOT_DETECT_CTRL  0x69
 #define USER_CTRL        0x6A  // Bit 7 enable DMP, bit 3 reset DMP
 #define PWR_MGMT_1       0x6B // Device defaults to the SLEEP mode
 #define PWR_MGMT_2       0x6C
@@ -71,55 +80,58 @@ enum Gscale {
   GFS_2000DPS
 };
 
+// Sample rate, filter and full-scale settings of one profile
+typedef struct {
+  const char *name;
+  uint16_t rate;        // Output data rate in Hz
+  uint8_t smplrtDiv;    // Rate = 1 kHz / (1 + SMPLRT_DIV)
+  uint8_t dlpf;         // CONFIG DLPF_CFG, gyro and thermometer bandwidth
+  uint8_t accelDlpf;    // ACCEL_CONFIG2 A_DLPFCFG, accelerometer bandwidth
+  uint8_t gscale;
+  uint8_t ascale;
+} ProfileConfig;
+
+static const ProfileConfig profiles[MPU9250_PROFILE_COUNT] = {
+  [MPU9250_PROFILE_GESTURE]   = { "gesture",   200,  4, 0x03, 0x03, GFS_250DPS,  AFS_8G  },
+  [MPU9250_PROFILE_LOW_POWER] = { "lowpower",   25, 39, 0x05, 0x05, GFS_250DPS,  AFS_4G  },
+  [MPU9250_PROFILE_VIBRATION] = { "vibration", 1000, 0, 0x01, 0x01, GFS_2000DPS, AFS_16G },
+};
+
+// Resolution per LSB for each full-scale setting, indexed by Ascale / Gscale
+static const float aResTable[4] = { 2.0/32768.0, 4.0/32768.0, 8.0/32768.0, 16.0/32768.0 };
+static const float gResTable[4] = { 250.0/32768.0, 500.0/32768.0, 1000.0/32768.0, 2000.0/32768.0 };
+
 // Prototypes
 void initMPU9250();
+static void applyProfile(const ProfileConfig *p);
 void accelgyrocalMPU9250(float *dest1, float *dest2);
 void MPU9250SelfTest(float * destination);
 
 I2C_Handle i2c;
 
-// Specify sensor full scale
+// Specify sensor full scale, set from the active profile
+static mpu9250_profile_t activeProfile = MPU9250_PROFILE_GESTURE;
 uint8_t Gscale = GFS_250DPS;
 uint8_t Ascale = AFS_8G;
 float aRes, gRes;      // scale resolutions per LSB for the sensors
 float gyroBias[3] = {0, 0, 0}, accelBias[3] = {0, 0, 0};      // Bias corrections for gyro and accelerometer
+int16_t accelBiasRaw[3] = {0, 0, 0};  // accelBias in LSB at the current Ascale, for the integer path
+bool selfTestValid = false;
 float SelfTest[6];
 
 void writeByte(uint8_t reg, uint8_t data) {
 
-	I2C_Transaction i2cTransaction;
-	uint8_t txBuffer[2];
-
-	txBuffer[0] = reg;
-	txBuffer[1] = data;
-    i2cTransaction.slaveAddress = Board_MPU9250_ADDR;
-    i2cTransaction.writeBuf = txBuffer;
-    i2cTransaction.writeCount = 2;
-    i2cTransaction.readBuf = NULL;
-    i2cTransaction.readCount = 0;
-
-    if (!I2C_transfer(i2c, &i2cTransaction)) {
-    	System_printf("MPU9250: write=%x data=%x FAILED\n",reg,data);
-    }
-    System_flush();
+	i2c_reg_write(i2c, Board_MPU9250_ADDR, reg, data);
 }
 
-void readByte(uint8_t reg, uint8_t count, uint8_t *data) {
+void readByte(uint8_t reg, uint16_t count, uint8_t *data) {
 
-	I2C_Transaction i2cTransaction;
-	uint8_t txBuffer[1];
+	i2c_reg_read(i2c, Board_MPU9250_ADDR, reg, count, data);
+}
 
-	txBuffer[0] = reg;
-    i2cTransaction.slaveAddress = Board_MPU9250_ADDR;
-    i2cTransaction.writeBuf = txBuffer;
-    i2cTransaction.writeCount = 1;
-    i2cTransaction.readBuf = data;
-    i2cTransaction.readCount = count;
+static void applyTable(const i2c_reg_op_t *ops, uint8_t count) {
 
-    if (!I2C_transfer(i2c, &i2cTransaction)) {
-    	System_printf("MPU9250: read=%x count=%x FAILED\n",reg,count);
-    }
-    System_flush();
+	i2c_reg_apply(i2c, Board_MPU9250_ADDR, ops, count);
 }
 
 void delay(uint16_t delay) {
@@ -127,50 +139,61 @@ void delay(uint16_t delay) {
 	Task_sleep(delay*1000 / Clock_tickPeriod);
 }
 
-void getGres() {
-
-  switch (Gscale) {
- 		// Possible gyro scales (and their register bit settings) are:
-		// 250 DPS (00), 500 DPS (01), 1000 DPS (10), and 2000 DPS  (11).
-        // Here's a bit of an algorith to calculate DPS/(ADC tick) based on that 2-bit value:
-    case GFS_250DPS:
-          gRes = 250.0/32768.0;
-          break;
-    case GFS_500DPS:
-          gRes = 500.0/32768.0;
-          break;
-    case GFS_1000DPS:
-          gRes = 1000.0/32768.0;
-          break;
-    case GFS_2000DPS:
-          gRes = 2000.0/32768.0;
-          break;
-  }
-}
-
-void getAres() {
-
-  switch (Ascale) {
-  	  	  // Possible accelerometer scales (and their register bit settings) are:
-  	  	  // 2 Gs (00), 4 Gs (01), 8 Gs (10), and 16 Gs  (11).
-  	  	  // Here's a bit of an algorith to calculate DPS/(ADC tick) based on that 2-bit value:
-    case AFS_2G:
-          aRes = 2.0/32768.0;
-          break;
-    case AFS_4G:
-          aRes = 4.0/32768.0;
-          break;
-    case AFS_8G:
-          aRes = 8.0/32768.0;
-          break;
-    case AFS_16G:
-          aRes = 16.0/32768.0;
-          break;
-  }
+// Convert the accelerometer bias into counts at the current full scale
+static void updateBiasRaw() {
+	uint8_t i;
+
+	for (i = 0; i < 3; i++) {
+		accelBiasRaw[i] = (int16_t)(accelBias[i] / aRes + (accelBias[i] < 0 ? -0.5f : 0.5f));
+	}
+}
+
+// Restore biases from flash and push the gyro offsets back to the chip
+static bool loadCalibration() {
+	mpu9250_calibration_t cal;
+	uint8_t i;
+
+	if (flash_store_read(FLASH_STORE_MPU9250_CAL, MPU9250_CAL_VERSION, &cal, sizeof(cal)) != FLASH_STORE_OK) {
+		return false;
+	}
+
+	for (i = 0; i < 3; i++) {
+		gyroBias[i] = cal.gyroBias[i];
+		accelBias[i] = cal.accelBias[i];
+	}
+	for (i = 0; i < 6; i++) {
+		SelfTest[i] = cal.selfTest[i];
+	}
+	i2c_reg_write_burst(i2c, Board_MPU9250_ADDR, XG_OFFSET_H, cal.gyroOffset, 6);
+	selfTestValid = cal.selfTestValid;
+	return true;
+}
+
+static void saveCalibration() {
+	mpu9250_calibration_t cal;
+	uint8_t i;
+
+	for (i = 0; i < 3; i++) {
+		cal.gyroBias[i] = gyroBias[i];
+		cal.accelBias[i] = accelBias[i];
+	}
+	for (i = 0; i < 6; i++) {
+		cal.selfTest[i] = SelfTest[i];
+	}
+	readByte(XG_OFFSET_H, 6, cal.gyroOffset);
+	cal.selfTestValid = selfTestValid;
+	cal.reserved = 0;
+
+	if (flash_store_write(FLASH_STORE_MPU9250_CAL, MPU9250_CAL_VERSION, &cal, sizeof(cal)) != FLASH_STORE_OK) {
+		System_printf("MPU9250: Saving calibration FAILED\n");
+	}
 }
 
 void mpu9250_setup(I2C_Handle *i2c_orig) {
 
+	Types_FreqHz freq;
+	uint32_t start = Timestamp_get32();
+
 	i2c = *i2c_orig;
 
 	System_printf("MPU9250: Setup start...\n");
@@ -181,128 +204,102 @@ void mpu9250_setup(I2C_Handle *i2c_orig) {
 	// readByte( WHO_AM_I_MPU9250, 1, &c);  // Read WHO_AM_I register for MPU-9250
 	// delay(100);
 
-	MPU9250SelfTest(SelfTest); // Start by performing self test and reporting values
-	delay(100);
+	// get sensor resolutions of the boot profile
+	aRes = aResTable[Ascale];
+	gRes = gResTable[Gscale];
 
-	// get sensor resolutions, only need to do this once
-	getAres();
-	getGres();
+	// A stored calibration skips bias estimation on warm boots. The self test is
+	// not part of startup, it runs on demand with mpu9250_self_test().
+	if (loadCalibration()) {
+		System_printf("MPU9250: Calibration loaded\n");
+	}
+	else {
+		accelgyrocalMPU9250(gyroBias, accelBias); // Calibrate gyro and accelerometers, load biases in bias registers
+		saveCalibration();
+	}
 
-	accelgyrocalMPU9250(gyroBias, accelBias); // Calibrate gyro and accelerometers, load biases in bias registers
-	delay(100);
+	// Accelerometer bias in counts so samples can be corrected without floating point
+	updateBiasRaw();
 
+	// initMPU9250() ends with its own settle time
 	initMPU9250();
-	delay(100);
 
-	System_printf("MPU9250: Setup OK\n");
+	Timestamp_getFreq(&freq);
+	System_printf("MPU9250: Setup OK in %u ms\n", (Timestamp_get32() - start) / (freq.lo / 1000));
 	System_flush();
 }
 
+// Wake up and select a stable clock source
+static const i2c_reg_op_t wakeSequence[] = {
+	{ PWR_MGMT_1, 0x00, I2C_REG_ALL, 100 }, // Clear sleep mode bit (6), enable all sensors, wait for registers to reset
+	{ PWR_MGMT_1, 0x01, I2C_REG_ALL, 200 }, // Auto select clock source to be PLL gyroscope reference if ready
+};
+
+// Configure Interrupts and Bypass Enable
+// Set interrupt pin active high, push-pull, 50 us pulse, clear on any read, and enable
+// I2C_BYPASS_EN so the AK8963 can be reached directly on the sensor bus
+static const i2c_reg_op_t interruptSequence[] = {
+	{ INT_PIN_CFG, 0x12, I2C_REG_ALL, 0 },
+	{ INT_ENABLE,  0x01, I2C_REG_ALL, 100 }, // Enable data ready (bit 0) interrupt
+};
+
 void initMPU9250() {
 
-	// wake up device
-	writeByte(PWR_MGMT_1, 0x00); // Clear sleep mode bit (6), enable all sensors
-	delay(100); // Wait for all registers to reset
-
-	// get stable time source
-	writeByte(PWR_MGMT_1, 0x01);  // Auto select clock source to be PLL gyroscope reference if ready else
-	delay(200);
-
-	// Configure Gyro and Thermometer
-	// Disable FSYNC and set thermometer and gyro bandwidth to 41 and 42 Hz, respectively;
-	// minimum delay time for this setting is 5.9 ms, which means sensor fusion update rates cannot
-	// be higher than 1 / 0.0059 = 170 Hz
-	// DLPF_CFG = bits 2:0 = 011; this limits the sample rate to 1000 Hz for both
-	// With the MPU9250, it is possible to get gyro sample rates of 32 kHz (!), 8 kHz, or 1 kHz
-	writeByte(CONFIG, 0x03);
-
-	// Set sample rate = gyroscope output rate/(1 + SMPLRT_DIV)
-	writeByte(SMPLRT_DIV, 0x04);  	// Use a 200 Hz rate; a rate consistent with the filter update rate
-                                    				// determined inset in CONFIG above
-
-	// Set gyroscope full scale range
-	// Range selects FS_SEL and AFS_SEL are 0 - 3, so 2-bit values are left-shifted into positions 4:3
-	uint8_t c;
-	readByte( GYRO_CONFIG, 1, &c); // get current GYRO_CONFIG register value
-	// c = c & ~0xE0; // Clear self-test bits [7:5]
-	c = c & ~0x02; // Clear Fchoice bits [1:0]
-	c = c & ~0x18; // Clear AFS bits [4:3]
-	c = c | Gscale << 3; // Set full scale range for the gyro
-	// c =| 0x00; // Set Fchoice for the gyro to 11 by writing its inverse to bits 1:0 of GYRO_CONFIG
-	writeByte(GYRO_CONFIG, c ); // Write new GYRO_CONFIG value to register
-
-	// Set accelerometer full-scale range configuration
-	readByte( ACCEL_CONFIG,1,&c); // get current ACCEL_CONFIG register value
-	// c = c & ~0xE0; // Clear self-test bits [7:5]
-	c = c & ~0x18;  // Clear AFS bits [4:3]
-	c = c | Ascale << 3; // Set full scale range for the accelerometer
-	writeByte(ACCEL_CONFIG, c); // Write new ACCEL_CONFIG register value
-
-	// Set accelerometer sample rate configuration
-	// It is possible to get a 4 kHz sample rate from the accelerometer by choosing 1 for
-	// accel_fchoice_b bit [3]; in this case the bandwidth is 1.13 kHz
-	readByte( ACCEL_CONFIG2, 1, &c); // get current ACCEL_CONFIG2 register value
-	c = c & ~0x0F; // Clear accel_fchoice_b (bit 3) and A_DLPFG (bits [2:0])
-	c = c | 0x03;  // Set accelerometer rate to 1 kHz and bandwidth to 41 Hz
-	writeByte( ACCEL_CONFIG2, c); // Write new ACCEL_CONFIG2 register value
-
-	// The accelerometer, gyro, and thermometer are set to 1 kHz sample rates,
-	// but all these rates are further reduced by a factor of 5 to 200 Hz because of the SMPLRT_DIV setting
-
-	// Configure Interrupts and Bypass Enable
-	// Set interrupt pin active high, push-pull, hold interrupt pin level HIGH until interrupt cleared,
-	// clear on read of INT_STATUS, and enable I2C_BYPASS_EN so additional chips
-	// can join the I2C bus and all can be controlled by the Arduino as master
-	//   writeByte( INT_PIN_CFG, 0x22);
-	writeByte( INT_PIN_CFG, 0x12);  // INT is 50 microsecond pulse and any read to clear
-	writeByte( INT_ENABLE, 0x01);  // Enable data ready (bit 0) interrupt
-	delay(100);
-}
+	applyTable(wakeSequence, I2C_REG_TABLE_SIZE(wakeSequence));
 
+	// Rate, filter bandwidths and full scale come from the active profile, see applyProfile()
+	applyProfile(&profiles[activeProfile]);
 
-// Function which accumulates gyro and accelerometer data after device initialization. It calculates the average
-// of the at-rest readings and then loads the resulting offsets into accelerometer and gyro bias registers.
-void accelgyrocalMPU9250(float *dest1, float *dest2) {
+	applyTable(interruptSequence, I2C_REG_TABLE_SIZE(interruptSequence));
+}
 
-	uint8_t data[12]; // data array to hold accelerometer and gyro x, y, z, data
-	uint16_t ii, packet_count, fifo_count;
-	int32_t gyro_bias[3]  = {0, 0, 0}, accel_bias[3] = {0, 0, 0};
 
+// Device reset and bias capture steps of accelgyrocalMPU9250()
+static const i2c_reg_op_t calibrationSequence[] = {
 	// reset device
-	writeByte( PWR_MGMT_1, 0x80); // Write a one to bit 7 reset bit; toggle reset device
-	delay(100);
+	{ PWR_MGMT_1,   0x80, I2C_REG_ALL, 100 }, // Write a one to bit 7 reset bit; toggle reset device
 
 	// get stable time source; Auto select clock source to be PLL gyroscope reference if ready
 	// else use the internal oscillator, bits 2:0 = 001
-	writeByte( PWR_MGMT_1, 0x01);
-	writeByte( PWR_MGMT_2, 0x00);
-	delay(200);
+	{ PWR_MGMT_1,   0x01, I2C_REG_ALL, 0 },
+	{ PWR_MGMT_2,   0x00, I2C_REG_ALL, 200 },
 
 	// Configure device for bias calculation
-	writeByte( INT_ENABLE, 0x00);   // Disable all interrupts
-	writeByte( FIFO_EN, 0x00);      // Disable FIFO
-	writeByte( PWR_MGMT_1, 0x00);   // Turn on internal clock source
-	writeByte( I2C_MST_CTRL, 0x00); // Disable I2C master
-	writeByte( USER_CTRL, 0x00);    // Disable FIFO and I2C master modes
-	writeByte( USER_CTRL, 0x0C);    // Reset FIFO and DMP
-	delay(15);
-
-	// Configure MPU6050 gyro and accelerometer for bias calculation
-	writeByte( CONFIG, 0x01);      // Set low-pass filter to 188 Hz
-	writeByte( SMPLRT_DIV, 0x00);  // Set sample rate to 1 kHz
-	writeByte( GYRO_CONFIG, 0x00);  // Set gyro full-scale to 250 degrees per second, maximum sensitivity
-	writeByte( ACCEL_CONFIG, 0x00); // Set accelerometer full-scale to 2 g, maximum sensitivity
+	{ INT_ENABLE,   0x00, I2C_REG_ALL, 0 },   // Disable all interrupts
+	{ FIFO_EN,      0x00, I2C_REG_ALL, 0 },   // Disable FIFO
+	{ PWR_MGMT_1,   0x00, I2C_REG_ALL, 0 },   // Turn on internal clock source
+	{ I2C_MST_CTRL, 0x00, I2C_REG_ALL, 0 },   // Disable I2C master
+	{ USER_CTRL,    0x00, I2C_REG_ALL, 0 },   // Disable FIFO and I2C master modes
+	{ USER_CTRL,    0x0C, I2C_REG_ALL, 15 },  // Reset FIFO and DMP
+
+	// Configure gyro and accelerometer for bias calculation
+	{ CONFIG,       0x01, I2C_REG_ALL, 0 },   // Set low-pass filter to 188 Hz
+	{ SMPLRT_DIV,   0x00, I2C_REG_ALL, 0 },   // Set sample rate to 1 kHz
+	{ GYRO_CONFIG,  0x00, I2C_REG_ALL, 0 },   // Set gyro full-scale to 250 degrees per second, maximum sensitivity
+	{ ACCEL_CONFIG, 0x00, I2C_REG_ALL, 0 },   // Set accelerometer full-scale to 2 g, maximum sensitivity
+
+	// Configure FIFO to capture accelerometer and gyro data for bias calculation
+	{ USER_CTRL,    0x40, I2C_REG_ALL, 0 },   // Enable FIFO
+	{ FIFO_EN,      0x78, I2C_REG_ALL, 40 },  // Enable gyro and accelerometer sensors for FIFO, 40 samples in 40 ms = 480 bytes
+
+	// At end of sample accumulation, turn off FIFO sensor read
+	{ FIFO_EN,      0x00, I2C_REG_ALL, 0 },
+};
+
+// Function which accumulates gyro and accelerometer data after device initialization. It calculates the average
+// of the at-rest readings and then loads the resulting offsets into accelerometer and gyro bias registers.
+void accelgyrocalMPU9250(float *dest1, float *dest2) {
+
+	uint8_t data[12]; // data array to hold accelerometer and gyro x, y, z, data
+	uint16_t ii, packet_count, fifo_count;
+	int32_t gyro_bias[3]  = {0, 0, 0}, accel_bias[3] = {0, 0, 0};
 
 	uint16_t  gyrosensitivity  = 131;   // = 131 LSB/degrees/sec
 	uint16_t  accelsensitivity = 16384;  // = 16384 LSB/g
 
-	// Configure FIFO to capture accelerometer and gyro data for bias calculation
-	writeByte( USER_CTRL, 0x40);   // Enable FIFO
-	writeByte( FIFO_EN, 0x78);     // Enable gyro and accelerometer sensors for FIFO  (max size 512 bytes in MPU-9150)
-	delay(40); // accumulate 40 samples in 40 milliseconds = 480 bytes
+	// Reset, configure for bias calculation and accumulate 40 samples in the FIFO
+	applyTable(calibrationSequence, I2C_REG_TABLE_SIZE(calibrationSequence));
 
-	// At end of sample accumulation, turn off FIFO sensor read
-	writeByte( FIFO_EN, 0x00);        // Disable gyro and accelerometer sensors for FIFO
 	readByte( FIFO_COUNTH, 2, &data[0]); // read FIFO sample count
 	fifo_count = ((uint16_t)data[0] << 8) | data[1];
 	packet_count = fifo_count/12;// How many sets of full gyro and accelerometer data for averaging
@@ -343,13 +340,8 @@ void accelgyrocalMPU9250(float *dest1, float *dest2) {
     data[4] = (-gyro_bias[2]/4  >> 8) & 0xFF;
     data[5] = (-gyro_bias[2]/4)       & 0xFF;
 
-    // Push gyro biases to hardware registers
-    writeByte( XG_OFFSET_H, data[0]);
-    writeByte( XG_OFFSET_L, data[1]);
-    writeByte( YG_OFFSET_H, data[2]);
-    writeByte( YG_OFFSET_L, data[3]);
-    writeByte( ZG_OFFSET_H, data[4]);
-    writeByte( ZG_OFFSET_L, data[5]);
+    // Push gyro biases to hardware registers, XG_OFFSET_H .. ZG_OFFSET_L are consecutive
+    i2c_reg_write_burst(i2c, Board_MPU9250_ADDR, XG_OFFSET_H, data, 6);
 
     // Output scaled gyro biases for display in the main program
     dest1[0] = (float) gyro_bias[0]/(float) gyrosensitivity;
@@ -407,6 +399,15 @@ void accelgyrocalMPU9250(float *dest1, float *dest2) {
     dest2[2] = (float)accel_bias[2]/(float)accelsensitivity;
 }
 
+// Self test measurement settings, full scale FS = 0
+static const i2c_reg_op_t selfTestSequence[] = {
+	{ SMPLRT_DIV,    0x00, I2C_REG_ALL, 0 }, // Set gyro sample rate to 1 kHz
+	{ CONFIG,        0x02, I2C_REG_ALL, 0 }, // Set gyro sample rate to 1 kHz and DLPF to 92 Hz
+	{ GYRO_CONFIG,   0x00, I2C_REG_ALL, 0 }, // Set full scale range for the gyro to 250 dps
+	{ ACCEL_CONFIG2, 0x02, I2C_REG_ALL, 0 }, // Set accelerometer rate to 1 kHz and bandwidth to 92 Hz
+	{ ACCEL_CONFIG,  0x00, I2C_REG_ALL, 0 }, // Set full scale range for the accelerometer to 2 g
+};
+
 // Accelerometer and gyroscope self test; check calibration wrt factory settings
 void MPU9250SelfTest(float * destination) // Should return percent deviation from factory trim values, +/- 14 or less deviation is a pass
 {
@@ -417,11 +418,7 @@ void MPU9250SelfTest(float * destination) // Should return percent deviation fro
 	float factoryTrim[6];
 	uint8_t FS = 0;
 
-	writeByte( SMPLRT_DIV, 0x00);    // Set gyro sample rate to 1 kHz
-	writeByte( CONFIG, 0x02);        // Set gyro sample rate to 1 kHz and DLPF to 92 Hz
-	writeByte( GYRO_CONFIG, FS<<3);  // Set full scale range for the gyro to 250 dps
-	writeByte( ACCEL_CONFIG2, 0x02); // Set accelerometer rate to 1 kHz and bandwidth to 92 Hz
-	writeByte( ACCEL_CONFIG, FS<<3); // Set full scale range for the accelerometer to 2 g
+	applyTable(selfTestSequence, I2C_REG_TABLE_SIZE(selfTestSequence));
 
 	for(ii = 0; ii < 200; ii++) {  // get average current values of gyro and acclerometer
 
@@ -493,30 +490,332 @@ void MPU9250SelfTest(float * destination) // Should return percent deviation fro
 	}
 }
 
+// Program sample rate, low-pass filters and full scale of a profile
+static void applyProfile(const ProfileConfig *p) {
+
+	const i2c_reg_op_t ops[] = {
+		// Disable FSYNC and set the gyro and thermometer bandwidth, e.g. DLPF_CFG = 011 gives 41 and 42 Hz;
+		// every DLPF setting used here keeps the internal sample rate at 1 kHz
+		{ CONFIG,        p->dlpf,        I2C_REG_ALL, 0 },
+		// Set sample rate = gyroscope output rate/(1 + SMPLRT_DIV)
+		{ SMPLRT_DIV,    p->smplrtDiv,   I2C_REG_ALL, 0 },
+		// Full scale in bits 4:3, Fchoice_b bit 1 cleared
+		{ GYRO_CONFIG,   p->gscale << 3, 0x1A, 0 },
+		{ ACCEL_CONFIG,  p->ascale << 3, 0x18, 0 },
+		// Accelerometer bandwidth in A_DLPFCFG bits 2:0, accel_fchoice_b bit 3 cleared keeps the 1 kHz internal rate
+		{ ACCEL_CONFIG2, p->accelDlpf,   0x0F, 0 },
+	};
+
+	applyTable(ops, I2C_REG_TABLE_SIZE(ops));
+
+	Gscale = p->gscale;
+	Ascale = p->ascale;
+	aRes = aResTable[Ascale];
+	gRes = gResTable[Gscale];
+}
+
 /**************** JTKJ: DO NOT MODIFY ANYTHING ABOVE THIS LINE ****************/
 
-void mpu9250_get_data(I2C_Handle *i2c, float *ax, float *ay, float *az, float *gx, float *gy, float *gz) {
+// Read one accel + gyro sample in a single 14 byte transfer, without bias correction
+static void readSample(mpu9250_sample_t *sample) {
     uint8_t rawData[14]; // Register data
 
     // Read register values into array rawData
     readByte(ACCEL_XOUT_H, 14, rawData);
 
     // Convert the 8-bit values (the _h and _l registers) in the array rawData into 16-bit values
-    int16_t nx = (rawData[0] << 8) | rawData[1];
-    int16_t ny = (rawData[2] << 8) | rawData[3];
-    int16_t nz = (rawData[4] << 8) | rawData[5];
-    int16_t mx = (rawData[8] << 8) | rawData[9];
-    int16_t my = (rawData[10] << 8) | rawData[11];
-    int16_t mz = (rawData[12] << 8) | rawData[13];
+    // Bytes 6 and 7 hold the temperature which is not used
+    sample->accel[0] = (rawData[0] << 8) | rawData[1];
+    sample->accel[1] = (rawData[2] << 8) | rawData[3];
+    sample->accel[2] = (rawData[4] << 8) | rawData[5];
+    sample->gyro[0] = (rawData[8] << 8) | rawData[9];
+    sample->gyro[1] = (rawData[10] << 8) | rawData[11];
+    sample->gyro[2] = (rawData[12] << 8) | rawData[13];
+}
+
+// Subtract the accelerometer bias in counts, saturating at the int16 range
+static void removeBias(mpu9250_sample_t *sample) {
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        int32_t v = (int32_t)sample->accel[i] - accelBiasRaw[i];
+        if (v > INT16_MAX) v = INT16_MAX;
+        if (v < INT16_MIN) v = INT16_MIN;
+        sample->accel[i] = (int16_t)v;
+    }
+}
+
+void mpu9250_get_data(I2C_Handle *i2c, float *ax, float *ay, float *az, float *gx, float *gy, float *gz) {
+    mpu9250_sample_t sample;
+
+    mpu9250_get_data_raw(i2c, &sample);
+    mpu9250_scale(&sample, ax, ay, az, gx, gy, gz);
+}
+
+void mpu9250_get_data_raw(I2C_Handle *i2c, mpu9250_sample_t *sample) {
+
+    readSample(sample);
+    removeBias(sample);
+}
+
+void mpu9250_scale(const mpu9250_sample_t *sample, float *ax, float *ay, float *az, float *gx, float *gy, float *gz) {
 
     // Convert the 16-bit register values into g
-    // Each nx, ny and nz below represents the 16-bit values for each axis separately
-    *ax = (float)nx * aRes - accelBias[0];
-    *ay = (float)ny * aRes - accelBias[1];
-    *az = (float)nz * aRes - accelBias[2];
-
-    // Convert g values mx, my, mz into degrees per second
-    *gx = (float)mx * gRes;
-    *gy = (float)my * gRes;
-    *gz = (float)mz * gRes;
+    *ax = (float)sample->accel[0] * aRes;
+    *ay = (float)sample->accel[1] * aRes;
+    *az = (float)sample->accel[2] * aRes;
+
+    // Convert the 16-bit gyro values into degrees per second
+    *gx = (float)sample->gyro[0] * gRes;
+    *gy = (float)sample->gyro[1] * gRes;
+    *gz = (float)sample->gyro[2] * gRes;
+}
+
+void mpu9250_scale_q16(const mpu9250_sample_t *sample, int32_t accel[3], int32_t gyro[3]) {
+    uint8_t i;
+
+    // One LSB is (2 << Ascale) / 32768 g = (4 << Ascale) in Q16.16,
+    // and (250 << Gscale) / 32768 dps = (500 << Gscale) in Q16.16
+    for (i = 0; i < 3; i++) {
+        accel[i] = (int32_t)sample->accel[i] << (Ascale + 2);
+        gyro[i] = (int32_t)sample->gyro[i] * (500 << Gscale);
+    }
+}
+
+// Gyro rate in LSB at the current full scale, 131 LSB per dps at 250 dps
+int16_t mpu9250_dps_to_raw(uint16_t dps) {
+
+    int32_t raw = ((int32_t)dps * 131) >> Gscale;
+    return raw > INT16_MAX ? INT16_MAX : (int16_t)raw;
+}
+
+void mpu9250_get_scale(uint8_t *ascale, uint8_t *gscale) {
+
+    *ascale = Ascale;
+    *gscale = Gscale;
+}
+
+static const i2c_reg_op_t fifoStartSequence[] = {
+    { FIFO_EN,    0x00, I2C_REG_ALL, 0 },  // Stop capturing while the FIFO is reset
+    { USER_CTRL,  0x04, I2C_REG_ALL, 0 },  // Reset FIFO
+    { USER_CTRL,  0x40, I2C_REG_ALL, 0 },  // Enable FIFO
+    { FIFO_EN,    0x78, I2C_REG_ALL, 0 },  // Capture accelerometer and gyro xyz, 12 bytes per sample
+    { INT_ENABLE, 0x10, I2C_REG_ALL, 0 },  // Interrupt only on FIFO overflow, no per-sample data ready
+};
+
+static const i2c_reg_op_t fifoStopSequence[] = {
+    { FIFO_EN,    0x00, I2C_REG_ALL, 0 },
+    { USER_CTRL,  0x00, I2C_REG_ALL, 0 },
+    { INT_ENABLE, 0x01, I2C_REG_ALL, 0 },  // Back to the data ready interrupt
+};
+
+void mpu9250_fifo_start(I2C_Handle *i2c) {
+
+    applyTable(fifoStartSequence, I2C_REG_TABLE_SIZE(fifoStartSequence));
+}
+
+void mpu9250_fifo_stop(I2C_Handle *i2c) {
+
+    applyTable(fifoStopSequence, I2C_REG_TABLE_SIZE(fifoStopSequence));
+}
+
+int mpu9250_read_fifo(I2C_Handle *i2c, mpu9250_sample_t *buf, uint8_t max_samples) {
+    uint8_t status;
+    uint8_t count[2];
+    uint16_t fifo_count, frames, i;
+
+    // INT_STATUS is cleared by any read (INT_PIN_CFG), so read it before anything else
+    readByte(INT_STATUS, 1, &status);
+    readByte(FIFO_COUNTH, 2, count);
+    fifo_count = ((uint16_t)(count[0] & 0x1F) << 8) | count[1];
+
+    // On overflow the chip drops the oldest bytes and the frame boundaries are lost
+    if ((status & 0x10) || fifo_count % MPU9250_FIFO_FRAME_SIZE != 0 ||
+        fifo_count > MPU9250_FIFO_MAX_FRAMES * MPU9250_FIFO_FRAME_SIZE) {
+        writeByte(USER_CTRL, 0x44); // Reset FIFO, keep it enabled
+        return MPU9250_FIFO_OVERFLOW;
+    }
+
+    frames = fifo_count / MPU9250_FIFO_FRAME_SIZE;
+    if (frames > max_samples) {
+        frames = max_samples;
+    }
+    if (frames == 0) {
+        return 0;
+    }
+
+    // Burst read all frames straight into the caller's buffer, then swap the
+    // big endian register pairs in place
+    uint8_t *raw = (uint8_t *)buf;
+    readByte(FIFO_R_W, frames * MPU9250_FIFO_FRAME_SIZE, raw);
+
+    int16_t *value = (int16_t *)buf;
+    for (i = 0; i < frames * MPU9250_FIFO_FRAME_SIZE; i += 2) {
+        *value++ = (int16_t)(((uint16_t)raw[i] << 8) | raw[i + 1]);
+    }
+    for (i = 0; i < frames; i++) {
+        removeBias(&buf[i]);
+    }
+
+    return frames;
+}
+
+void mpu9250_set_profile(I2C_Handle *i2c, mpu9250_profile_t newProfile) {
+
+    if (newProfile >= MPU9250_PROFILE_COUNT) {
+        return;
+    }
+
+    applyProfile(&profiles[newProfile]);
+    updateBiasRaw();
+    activeProfile = newProfile;
+}
+
+mpu9250_profile_t mpu9250_get_profile(void) {
+
+    return activeProfile;
+}
+
+uint16_t mpu9250_sample_rate(void) {
+
+    return profiles[activeProfile].rate;
+}
+
+const char *mpu9250_profile_name(mpu9250_profile_t p) {
+
+    return p < MPU9250_PROFILE_COUNT ? profiles[p].name : NULL;
+}
+
+void mpu9250_calibrate(I2C_Handle *i2c) {
+
+    accelgyrocalMPU9250(gyroBias, accelBias); // Resets the device
+    updateBiasRaw();
+    initMPU9250();
+    saveCalibration();
+}
+
+// Residual gyro bias check over windows of MPU9250_DRIFT_SAMPLES. Whether the device was
+// really still is judged from the accelerometer, not from the gyro whose bias is in
+// question: every sample within 0.9..1.1 g, and the mean acceleration of the first and last
+// quarter of the window no more than MPU9250_DRIFT_TILT apart (about 1 degree of tilt), so
+// a slow deliberate rotation is not taken for drift. Rotation about the vertical leaves the
+// accelerometer alone, readings above MPU9250_DRIFT_MAX count as motion for that case
+#define MPU9250_DRIFT_SAMPLES  1024
+#define MPU9250_DRIFT_LIMIT    131         // 1 dps in LSB at 250 dps full scale
+#define MPU9250_DRIFT_MAX      (20 * 131)  // 20 dps, beyond any plausible residual bias
+#define MPU9250_DRIFT_TILT     60          // 1 g / 60, in accel LSB after scaling
+
+bool mpu9250_bias_drifted(const mpu9250_sample_t *sample) {
+    static int32_t sum[3] = {0, 0, 0};
+    static int32_t first[3] = {0, 0, 0}, last[3] = {0, 0, 0};
+    static uint16_t count = 0;
+    uint32_t g1 = 16384 >> Ascale;  // 1 g in LSB
+    uint32_t g2 = 0;
+    bool drifted = false;
+    uint8_t i;
+
+    for (i = 0; i < 3; i++) {
+        int32_t a = sample->accel[i];
+        g2 += (uint32_t)(a * a);
+    }
+    for (i = 0; i < 3; i++) {
+        int16_t g = sample->gyro[i];
+        if (g2 < g1 * g1 / 100 * 81 || g2 > g1 * g1 / 100 * 121
+                || g > (MPU9250_DRIFT_MAX >> Gscale) || g < -(MPU9250_DRIFT_MAX >> Gscale)) {
+            // Moving, start over
+            sum[0] = sum[1] = sum[2] = 0;
+            first[0] = first[1] = first[2] = 0;
+            last[0] = last[1] = last[2] = 0;
+            count = 0;
+            return false;
+        }
+        sum[i] += g;
+        if (count < MPU9250_DRIFT_SAMPLES / 4) {
+            first[i] += sample->accel[i];
+        }
+        else if (count >= MPU9250_DRIFT_SAMPLES - MPU9250_DRIFT_SAMPLES / 4) {
+            last[i] += sample->accel[i];
+        }
+    }
+
+    if (++count == MPU9250_DRIFT_SAMPLES) {
+        bool still = true;
+        for (i = 0; i < 3; i++) {
+            int32_t tilt = (last[i] - first[i]) / (MPU9250_DRIFT_SAMPLES / 4);
+            if (tilt > (int32_t)g1 / MPU9250_DRIFT_TILT || tilt < -(int32_t)g1 / MPU9250_DRIFT_TILT) {
+                still = false;
+            }
+        }
+        for (i = 0; i < 3; i++) {
+            int32_t mean = sum[i] / MPU9250_DRIFT_SAMPLES;
+            if (still && (mean > (MPU9250_DRIFT_LIMIT >> Gscale) || mean < -(MPU9250_DRIFT_LIMIT >> Gscale))) {
+                drifted = true;
+            }
+            sum[i] = first[i] = last[i] = 0;
+        }
+        count = 0;
+    }
+    return drifted;
+}
+
+bool mpu9250_self_test(I2C_Handle *i2c, mpu9250_self_test_t *result) {
+    bool passed = true;
+    uint8_t i;
+
+    MPU9250SelfTest(SelfTest);
+    selfTestValid = true;
+
+    // The self test leaves rate, filters and full scale at its own settings
+    applyProfile(&profiles[activeProfile]);
+    saveCalibration();
+
+    for (i = 0; i < 6; i++) {
+        result->deviation[i] = SelfTest[i];
+        result->pass[i] = SelfTest[i] <= MPU9250_SELF_TEST_LIMIT && SelfTest[i] >= -MPU9250_SELF_TEST_LIMIT;
+        passed = passed && result->pass[i];
+    }
+    return passed;
+}
+
+void mpu9250_wom_enter(I2C_Handle *i2c, uint16_t threshold_mg) {
+
+    uint16_t threshold = threshold_mg / 4; // 4 mg per LSB
+    if (threshold == 0) threshold = 1;
+    if (threshold > 0xFF) threshold = 0xFF;
+
+    const i2c_reg_op_t ops[] = {
+        { INT_ENABLE,      0x00, I2C_REG_ALL, 0 },  // No data-ready edges from here on
+        { FIFO_EN,         0x00, I2C_REG_ALL, 0 },
+        { USER_CTRL,       0x00, I2C_REG_ALL, 0 },  // FIFO off, it is not serviced in standby
+        { PWR_MGMT_1,      0x00, I2C_REG_ALL, 0 },  // Internal oscillator, gyro PLL is going down
+        { PWR_MGMT_2,      0x07, I2C_REG_ALL, 0 },  // Accelerometer on, gyro xyz off
+        { ACCEL_CONFIG2,   0x01, I2C_REG_ALL, 0 },  // Accelerometer bandwidth 184 Hz
+        { MOT_DETECT_CTRL, 0xC0, I2C_REG_ALL, 0 },  // Enable motion detection, compare against previous sample
+        { WOM_THR,         (uint8_t)threshold, I2C_REG_ALL, 0 },
+        { LP_ACCEL_ODR,    0x05, I2C_REG_ALL, 0 },  // Wake up the accelerometer at 7.81 Hz
+        { PWR_MGMT_1,      0x20, I2C_REG_ALL, 0 },  // Cycle mode
+    };
+
+    ak8963_sleep(i2c);
+    applyTable(ops, I2C_REG_TABLE_SIZE(ops));
+}
+
+void mpu9250_wom_arm(I2C_Handle *i2c) {
+
+    writeByte(INT_ENABLE, 0x40);       // Wake on motion interrupt only
+}
+
+static const i2c_reg_op_t womExitSequence[] = {
+    { INT_ENABLE,      0x00, I2C_REG_ALL, 0 },
+    { MOT_DETECT_CTRL, 0x00, I2C_REG_ALL, 0 },
+    { PWR_MGMT_1,      0x01, I2C_REG_ALL, 0 },  // Leave cycle mode, PLL clock source
+    { PWR_MGMT_2,      0x00, I2C_REG_ALL, 35 }, // Gyro back on, wait for its start-up time
+};
+
+void mpu9250_wom_exit(I2C_Handle *i2c) {
+
+    applyTable(womExitSequence, I2C_REG_TABLE_SIZE(womExitSequence));
+    applyProfile(&profiles[activeProfile]);
+    writeByte(INT_ENABLE, 0x01);       // Data ready interrupt
+    ak8963_wake(i2c);
 }
@@ -12,9 +12,96 @@
 #ifndef MPU9250_H_
 #define MPU9250_H_
 
+#include <stdint.h>
+#include <stdbool.h>
 #include <ti/drivers/I2C.h>
 
+#define MPU9250_FIFO_SIZE        512  // Bytes of FIFO memory in the chip
+#define MPU9250_FIFO_FRAME_SIZE  12   // One accel + gyro frame, temperature not stored
+#define MPU9250_FIFO_MAX_FRAMES  (MPU9250_FIFO_SIZE / MPU9250_FIFO_FRAME_SIZE)
+#define MPU9250_FIFO_OVERFLOW    (-1)
+
+// One raw accelerometer + gyroscope sample, same layout as a FIFO frame.
+// Samples returned by the driver have the accelerometer bias already removed.
+typedef struct {
+    int16_t accel[3];
+    int16_t gyro[3];
+} mpu9250_sample_t;
+
+// Calibration persisted in flash so warm boots can skip bias estimation
+#define MPU9250_CAL_VERSION  1
+
+typedef struct {
+    float gyroBias[3];      // Degrees per second, already removed in hardware
+    float accelBias[3];     // g
+    uint8_t gyroOffset[6];  // XG_OFFSET_H .. ZG_OFFSET_L as pushed to the chip
+    uint8_t selfTestValid;  // selfTest holds the result of a self test
+    uint8_t reserved;
+    float selfTest[6];      // Percent deviation from factory trim, accel xyz then gyro xyz
+} mpu9250_calibration_t;
+
+// Factory self test, run on demand: percent deviation of the self-test response
+// from factory trim per axis, +/- MPU9250_SELF_TEST_LIMIT or less is a pass
+#define MPU9250_SELF_TEST_LIMIT  14.0f
+
+typedef struct {
+    float deviation[6];  // accel xyz, gyro xyz
+    bool pass[6];
+} mpu9250_self_test_t;
+
+// Runs the self test (about 0.5 s of blocking reads), restores the active profile
+// and stores the outcome with the calibration. Returns true when every axis passes.
+bool mpu9250_self_test(I2C_Handle *i2c, mpu9250_self_test_t *result);
+
+// Wake-on-motion standby: gyro and magnetometer off and accelerometer duty cycled at
+// about 8 Hz. mpu9250_wom_enter() leaves the INT pin quiet, so a data-ready edge from
+// before standby can be discarded; mpu9250_wom_arm() then makes it pulse when any axis
+// changes by more than threshold_mg (4..1020 mg). mpu9250_wom_exit() restores full-rate
+// sampling with the active profile.
+void mpu9250_wom_enter(I2C_Handle *i2c, uint16_t threshold_mg);
+void mpu9250_wom_arm(I2C_Handle *i2c);
+void mpu9250_wom_exit(I2C_Handle *i2c);
+
+// Named output data rate / low-pass filter / full-scale profiles, switchable at runtime
+typedef enum {
+    MPU9250_PROFILE_GESTURE = 0,  // 200 Hz, 41 Hz bandwidth, 250 dps, 8 g (boot default)
+    MPU9250_PROFILE_LOW_POWER,    // 25 Hz, 10 Hz bandwidth, 250 dps, 4 g
+    MPU9250_PROFILE_VIBRATION,    // 1 kHz, 184 Hz bandwidth, 2000 dps, 16 g
+    MPU9250_PROFILE_COUNT
+} mpu9250_profile_t;
+
 void mpu9250_setup(I2C_Handle *i2c);
 void mpu9250_get_data(I2C_Handle *i2c, float *ax, float *ay, float *az, float *gx, float *gy, float *gz);
+void mpu9250_scale(const mpu9250_sample_t *sample, float *ax, float *ay, float *az, float *gx, float *gy, float *gz);
+
+// Re-estimate the biases with the device at rest and store them in flash
+void mpu9250_calibrate(I2C_Handle *i2c);
+
+// Watch at-rest gyro readings for residual bias; returns true once the average
+// over a still period exceeds the drift limit and a recalibration is due
+bool mpu9250_bias_drifted(const mpu9250_sample_t *sample);
+
+// Reprogram rate, filters and full scale without a re-init; samples read after the
+// call use the new resolution
+void mpu9250_set_profile(I2C_Handle *i2c, mpu9250_profile_t profile);
+mpu9250_profile_t mpu9250_get_profile(void);
+uint16_t mpu9250_sample_rate(void);
+const char *mpu9250_profile_name(mpu9250_profile_t profile);
+
+// Integer sample path, no floating point: raw counts at the configured full scale,
+// or g and degrees per second in Q16.16 fixed point
+void mpu9250_get_data_raw(I2C_Handle *i2c, mpu9250_sample_t *sample);
+void mpu9250_scale_q16(const mpu9250_sample_t *sample, int32_t accel[3], int32_t gyro[3]);
+int16_t mpu9250_dps_to_raw(uint16_t dps);
+
+// Full-scale codes of the active profile (AFS_xG / GFS_xDPS), raw counts scale as in mpu9250_scale_q16()
+void mpu9250_get_scale(uint8_t *ascale, uint8_t *gscale);
+
+// FIFO streaming: start/stop capturing accel + gyro frames at the configured sample rate
+// and drain up to max_samples frames in a single I2C transfer. Returns the number of
+// frames read or MPU9250_FIFO_OVERFLOW, in which case the FIFO has been reset.
+void mpu9250_fifo_start(I2C_Handle *i2c);
+void mpu9250_fifo_stop(I2C_Handle *i2c);
+int mpu9250_read_fifo(I2C_Handle *i2c, mpu9250_sample_t *buf, uint8_t max_samples);
 
 #endif /* MPU9250_H_ */
@@ -0,0 +1,205 @@
+/*
+ * flash_store.c
+ *
+ *  Record layout in its sector: header followed by the payload.
+ *  Erased flash reads as 0xFF, so an erased sector never has a valid magic.
+ *
+ *  On the tag the sectors are internal flash. Host builds keep an image of
+ *  them in a file with the same erase and program rules (programming can only
+ *  clear bits), so the record checks run unchanged.
+ */
+
+#include <string.h>
+
+#if defined(__TI_COMPILER_VERSION__)
+#include <xdc/std.h>
+#include <ti/sysbios/hal/Hwi.h>
+#include <driverlib/flash.h>
+#include <driverlib/vims.h>
+#else
+#include <stdio.h>
+#endif
+
+#include "storage/flash_store.h"
+
+#define FLASH_STORE_MAGIC  0x53544F52  // "STOR"
+
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    uint16_t crc;       // CRC-16/CCITT of the payload
+    uint16_t reserved;
+} RecordHeader;
+
+#if defined(__TI_COMPILER_VERSION__)
+
+static uint32_t recordAddress(uint8_t id) {
+
+    return FLASH_STORE_BASE + (uint32_t)id * FLASH_STORE_SECTOR_SIZE;
+}
+
+// Internal flash is memory mapped, read it in place
+static const uint8_t *sectorData(uint8_t id) {
+
+    return (const uint8_t *)recordAddress(id);
+}
+
+// Erase the sector, then program the payload first and the header last
+static int sectorWrite(uint8_t id, const RecordHeader *header, const void *data, uint16_t length) {
+    uint32_t address = recordAddress(id);
+    uint32_t status;
+
+    // Nothing may run from flash while it is erased or programmed, so interrupts (the MPU
+    // data-ready callback, the kernel) stay off for the whole sequence, up to one sector
+    // erase time. The cache and line buffers must not serve stale flash contents either
+    UInt key = Hwi_disable();
+    uint32_t vimsMode = VIMSModeGet(VIMS_BASE);
+    VIMSModeSet(VIMS_BASE, VIMS_MODE_DISABLED);
+    while (VIMSModeGet(VIMS_BASE) != VIMS_MODE_DISABLED);
+    VIMSLineBufDisable(VIMS_BASE);
+
+    status = FlashSectorErase(address);
+    if (status == FAPI_STATUS_SUCCESS) {
+        status = FlashProgram((uint8_t *)data, address + sizeof(*header), length);
+    }
+    if (status == FAPI_STATUS_SUCCESS) {
+        status = FlashProgram((uint8_t *)header, address, sizeof(*header));
+    }
+
+    VIMSLineBufEnable(VIMS_BASE);
+    VIMSModeSet(VIMS_BASE, vimsMode);
+    Hwi_restore(key);
+
+    return status == FAPI_STATUS_SUCCESS ? FLASH_STORE_OK : FLASH_STORE_ERROR;
+}
+
+#else
+
+static uint8_t image[FLASH_STORE_RECORDS * FLASH_STORE_SECTOR_SIZE];
+static FILE *imageFile = NULL;
+static int programsLeft = -1;
+
+int flash_store_host_open(const char *path) {
+
+    if (imageFile != NULL) {
+        fclose(imageFile);
+    }
+    memset(image, 0xFF, sizeof(image));
+    programsLeft = -1;
+
+    // A missing or short file reads as erased flash
+    imageFile = fopen(path, "r+b");
+    if (imageFile == NULL) {
+        imageFile = fopen(path, "w+b");
+    }
+    if (imageFile == NULL) {
+        return -1;
+    }
+    if (fread(image, 1, sizeof(image), imageFile) < sizeof(image)) {
+        clearerr(imageFile);
+    }
+    return 0;
+}
+
+void flash_store_host_fail_after(int programs) {
+
+    programsLeft = programs;
+}
+
+static const uint8_t *sectorData(uint8_t id) {
+
+    return image + (uint32_t)id * FLASH_STORE_SECTOR_SIZE;
+}
+
+// Programming clears bits only, like the flash controller
+static int program(uint8_t *dest, const void *data, uint16_t length) {
+    const uint8_t *src = data;
+    uint16_t i;
+
+    if (programsLeft == 0) {
+        return FLASH_STORE_ERROR;
+    }
+    if (programsLeft > 0) {
+        programsLeft--;
+    }
+    for (i = 0; i < length; i++) {
+        dest[i] &= src[i];
+    }
+    return FLASH_STORE_OK;
+}
+
+static int sectorWrite(uint8_t id, const RecordHeader *header, const void *data, uint16_t length) {
+    uint8_t *sector = image + (uint32_t)id * FLASH_STORE_SECTOR_SIZE;
+    int status;
+
+    if (imageFile == NULL) {
+        return FLASH_STORE_ERROR;
+    }
+
+    memset(sector, 0xFF, FLASH_STORE_SECTOR_SIZE);
+    status = program(sector + sizeof(*header), data, length);
+    if (status == FLASH_STORE_OK) {
+        status = program(sector, header, sizeof(*header));
+    }
+
+    // The file gets what the flash would hold, also after a failed program
+    rewind(imageFile);
+    if (fwrite(image, 1, sizeof(image), imageFile) != sizeof(image) || fflush(imageFile) != 0) {
+        return FLASH_STORE_ERROR;
+    }
+    return status;
+}
+
+#endif
+
+uint16_t flash_store_crc16(const uint8_t *data, uint16_t length) {
+    uint16_t crc = 0xFFFF;
+    uint8_t i;
+
+    while (length--) {
+        crc ^= (uint16_t)(*data++) << 8;
+        for (i = 0; i < 8; i++) {
+            crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+int flash_store_read(uint8_t id, uint16_t version, void *data, uint16_t length) {
+
+    if (id >= FLASH_STORE_RECORDS) {
+        return FLASH_STORE_INVALID;
+    }
+
+    const RecordHeader *header = (const RecordHeader *)sectorData(id);
+    const uint8_t *payload = (const uint8_t *)(header + 1);
+
+    if (header->magic != FLASH_STORE_MAGIC) {
+        return FLASH_STORE_EMPTY;
+    }
+    if (header->version != version || header->length != length ||
+        header->crc != flash_store_crc16(payload, length)) {
+        return FLASH_STORE_INVALID;
+    }
+
+    memcpy(data, payload, length);
+    return FLASH_STORE_OK;
+}
+
+int flash_store_write(uint8_t id, uint16_t version, const void *data, uint16_t length) {
+    RecordHeader header;
+
+    if (id >= FLASH_STORE_RECORDS || sizeof(header) + length > FLASH_STORE_SECTOR_SIZE) {
+        return FLASH_STORE_INVALID;
+    }
+
+    header.magic = FLASH_STORE_MAGIC;
+    header.version = version;
+    header.length = length;
+    header.crc = flash_store_crc16(data, length);
+    header.reserved = 0xFFFF;
+
+    // Payload first and header last, so an interrupted write leaves an invalid record
+    return sectorWrite(id, &header, data, length);
+}
@@ -0,0 +1,42 @@
+/*
+ * flash_store.h
+ *
+ *  Small records kept in reserved internal flash sectors, one sector per record.
+ *  Each record carries a version tag and a CRC so stale or torn writes are
+ *  detected and the caller can fall back to defaults.
+ *
+ *  The sectors are excluded from the application image in CC2650STK.cmd.
+ */
+
+#ifndef FLASH_STORE_H_
+#define FLASH_STORE_H_
+
+#include <stdint.h>
+
+#define FLASH_STORE_SECTOR_SIZE  0x1000
+#define FLASH_STORE_BASE         0x1D000  // First reserved sector, must match CC2650STK.cmd
+
+// Record ids, one flash sector each
+#define FLASH_STORE_MPU9250_CAL  0
+#define FLASH_STORE_MOUNT_CAL    1
+#define FLASH_STORE_RECORDS      2
+
+#define FLASH_STORE_OK           0
+#define FLASH_STORE_EMPTY        (-1)  // Never written or erased
+#define FLASH_STORE_INVALID      (-2)  // Version, length or CRC mismatch
+#define FLASH_STORE_ERROR        (-3)  // Erase or program failed
+
+int flash_store_read(uint8_t id, uint16_t version, void *data, uint16_t length);
+int flash_store_write(uint8_t id, uint16_t version, const void *data, uint16_t length);
+uint16_t flash_store_crc16(const uint8_t *data, uint16_t length);
+
+#if !defined(__TI_COMPILER_VERSION__)
+// Host builds keep the sectors in a file, erased when it does not exist yet.
+// Open it before any read or write, returns -1 when it cannot be used
+int flash_store_host_open(const char *path);
+
+// Make the program step after the next n fail, as a power cut would. -1 never fails
+void flash_store_host_fail_after(int programs);
+#endif
+
+#endif /* FLASH_STORE_H_ */
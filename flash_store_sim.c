@@ -0,0 +1,111 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "storage/flash_store.h"
+#include "motion/mount.h"
+
+// Runs the flash records through boots of the tag against a file-backed flash image
+// (storage/flash_store.c in its host build): the first boot finds nothing and calibrates,
+// the next one loads the stored mounting calibration and skips it. Then the cases that
+// have to fall back to calibrating: a record from older firmware, a wrong size, a write
+// cut off by a power loss and a flipped bit. Exits non-zero when a check fails.
+// Build: gcc -O2 -ICSProject flash_store_sim.c CSProject/storage/flash_store.c CSProject/motion/mount.c CSProject/motion/fixmath.c -o flash_store_sim
+// Usage: flash_store_sim [image file]   default flash_store_sim.bin, deleted first
+
+static const char *path = "flash_store_sim.bin";
+static int failed = 0;
+
+static void check(const char *what, int ok) {
+    printf("%-48s %s\n", what, ok ? "ok" : "FAILED");
+    failed += !ok;
+}
+
+// Power cycle: the flash image is whatever the file holds
+static void boot(void) {
+    if (flash_store_host_open(path) != 0) {
+        perror(path);
+        exit(1);
+    }
+}
+
+// What the firmware does at startup: use the stored record or calibrate and store a new one
+static int bootMount(mount_t *mount, const mount_t *calibrated) {
+    boot();
+    int status = flash_store_read(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION, mount, sizeof(*mount));
+    if (status != FLASH_STORE_OK) {
+        *mount = *calibrated;
+        flash_store_write(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION, mount, sizeof(*mount));
+    }
+    return status;
+}
+
+static void flipByte(long offset) {
+    FILE *file = fopen(path, "r+b");
+    int c;
+    if (file == NULL || fseek(file, offset, SEEK_SET) != 0 || (c = fgetc(file)) == EOF) {
+        perror(path);
+        exit(1);
+    }
+    fseek(file, offset, SEEK_SET);
+    fputc(c ^ 0x04, file);
+    fclose(file);
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 2) {
+        printf("Usage: %s [image file]\n", argv[0]);
+        return 1;
+    }
+    if (argc == 2) path = argv[1];
+    remove(path);
+
+    // A calibration result as mount_cal_update() leaves it: sideways mount, custom reach
+    mount_t calibrated, mount;
+    mount_init(&calibrated);
+    calibrated.rot[0][0] = 0;
+    calibrated.rot[0][1] = -MOUNT_ONE;
+    calibrated.rot[1][0] = MOUNT_ONE;
+    calibrated.rot[1][1] = 0;
+    calibrated.dotReach = 72000;
+    calibrated.dashReach = 81000;
+    calibrated.spacePeak = 1420;
+    calibrated.valid = 1;
+
+    check("first boot: empty, calibrates", bootMount(&mount, &calibrated) == FLASH_STORE_EMPTY);
+    memset(&mount, 0, sizeof(mount));
+    check("second boot: loads the stored record", bootMount(&mount, &calibrated) == FLASH_STORE_OK);
+    check("loaded record equals the saved one", memcmp(&mount, &calibrated, sizeof(mount)) == 0);
+
+    // Another record in its own sector leaves this one alone
+    uint8_t other[40];
+    memset(other, 0x5A, sizeof(other));
+    check("second record written", flash_store_write(FLASH_STORE_MPU9250_CAL, 1, other, sizeof(other)) == FLASH_STORE_OK);
+    check("first record still loads", bootMount(&mount, &calibrated) == FLASH_STORE_OK);
+
+    // Firmware with a newer record version must not take the old layout
+    check("newer version: invalid", flash_store_read(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION + 1, &mount, sizeof(mount)) == FLASH_STORE_INVALID);
+    flash_store_write(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION - 1, &calibrated, sizeof(calibrated));
+    check("record from older firmware: recalibrates", bootMount(&mount, &calibrated) == FLASH_STORE_INVALID);
+    check("and the next boot loads the new record", bootMount(&mount, &calibrated) == FLASH_STORE_OK);
+    check("wrong length: invalid", flash_store_read(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION, &mount, sizeof(mount) - 2) == FLASH_STORE_INVALID);
+
+    // Power lost after the payload is programmed: the header is still erased
+    boot();
+    flash_store_host_fail_after(1);
+    check("write cut off after the payload fails", flash_store_write(FLASH_STORE_MOUNT_CAL, MOUNT_VERSION, &calibrated, sizeof(calibrated)) == FLASH_STORE_ERROR);
+    check("cut off record reads empty, recalibrates", bootMount(&mount, &calibrated) == FLASH_STORE_EMPTY);
+    check("and the next boot loads it", bootMount(&mount, &calibrated) == FLASH_STORE_OK);
+
+    // One flipped payload bit fails the CRC, the 12 byte header precedes the payload
+    flipByte((long)FLASH_STORE_MOUNT_CAL * FLASH_STORE_SECTOR_SIZE + 12 + 5);
+    check("flipped bit: invalid, recalibrates", bootMount(&mount, &calibrated) == FLASH_STORE_INVALID);
+    check("and the next boot loads the new record", bootMount(&mount, &calibrated) == FLASH_STORE_OK);
+    check("loaded record equals the saved one", memcmp(&mount, &calibrated, sizeof(mount)) == 0);
+
+    uint8_t back[40];
+    check("second record survived all of it", flash_store_read(FLASH_STORE_MPU9250_CAL, 1, back, sizeof(back)) == FLASH_STORE_OK
+          && memcmp(back, other, sizeof(back)) == 0);
+
+    return failed > 0;
+}
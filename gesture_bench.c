@@ -0,0 +1,724 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "motion/imu_trace.h"
+#include "motion/pipeline.h"
+#include "motion/fixmath.h"
+
+// Scores gesture detector configurations on labeled traces: built-in synthetic
+// scenarios (slow, fast, noisy, shallow with tremor, sideways mounted, tapping, DTW
+// flicks and twists with recorded templates) and recorded
+// traces from "#capture on" with a label file. Output is one CSV row per
+// configuration and trace, every column except cycles_per_sample is deterministic.
+// With -k it instead compares the integer kernels with the float and libm code they
+// replaced, error and time per call. The host has an FPU, so on the tag the float
+// rows cost far more than here (software floating point).
+// Build: gcc -O2 -ICSProject gesture_bench.c CSProject/motion/*.c -lm -o gesture_bench
+// Usage: gesture_bench [-g <enter deg> <exit deg> <dwell ms>] [-t <trace> <labels>]...
+//        gesture_bench -k
+//   labels: one "<seconds> <symbol>" line per gesture, symbol '.', '-' or '_' for a space,
+//   the time is when the motion starts
+
+#define RATE          200
+#define ASCALE        2        // 8 g, 4096 LSB per g
+#define GSCALE        0        // 250 dps, 131 LSB per dps
+#define MAX_SAMPLES   200000
+#define MAX_LABELS    1024
+#define MATCH_WINDOW  1.5      // A detection must follow its label within this many seconds
+#define KERNEL_INPUTS 4096
+#define KERNEL_ROUNDS 256      // Timed calls per kernel: inputs times rounds
+
+typedef struct {
+    double time;
+    char symbol;
+} label_t;
+
+typedef struct {
+    const char *name;
+    imu_trace_header_t header;
+    imu_trace_record_t *records;
+    int count;
+    label_t labels[MAX_LABELS];
+    int labelCount;
+    pipeline_mode_t mode;      // Detector mode the trace is meant for
+    imu_trace_record_t *calRecords;  // Mounting calibration by the same user, synthetic traces only
+    int calCount;
+    imu_trace_record_t *tplRecords[DTW_MAX_TEMPLATES];  // One recording per DTW template
+    int tplCount[DTW_MAX_TEMPLATES];
+    char tplSymbol[DTW_MAX_TEMPLATES];
+    int templates;
+} trace_t;
+
+typedef struct {
+    const char *name;
+    gesture_config_t gesture;
+    pipeline_mode_t mode;
+    int calibrate;             // Run the trace's mounting calibration first
+    int record;                // Record the trace's DTW templates first
+} detector_t;
+
+// Deterministic noise, xorshift32 and an approximately normal sum of uniforms
+static uint32_t rng;
+
+static double uniform(void) {
+    rng ^= rng << 13;
+    rng ^= rng >> 17;
+    rng ^= rng << 5;
+    return (rng & 0xFFFFFF) / (double)0x1000000;
+}
+
+static double normal(void) {
+    return uniform() + uniform() + uniform() + uniform() - 2.0;  // sd about 0.58
+}
+
+// Synthetic device state: roll in the operator's frame, mounted either flat or turned 90 degrees
+typedef struct {
+    trace_t *trace;
+    double roll;           // deg
+    double noiseG;         // accel noise, g
+    double noiseDps;       // gyro noise, dps
+    double tremor;         // Hand tremor amplitude at 8 Hz, deg
+    int sideways;
+    int n;
+    int axis;              // Axis rotate() turns about, 0 roll, 1 pitch, 2 yaw
+} synth_t;
+
+static int16_t clamp16(double value) {
+    if (value > 32767) return 32767;
+    if (value < -32768) return -32768;
+    return (int16_t)lround(value);
+}
+
+static void emit(synth_t *s, double rateDps, double extraAz) {
+    trace_t *t = s->trace;
+    if (t->count >= MAX_SAMPLES) return;
+
+    // Tremor adds its angular rate on top of the intended motion
+    rateDps += s->tremor * 2 * M_PI * 8 * cos(2 * M_PI * 8 * s->n++ / RATE);
+    // Only roll moves gravity in the accelerometer: yaw turns about gravity, and the pitch
+    // shakes are short enough that only the gyro matters to the detectors
+    double g[3] = { 0, 0, 0 };
+    g[s->axis] = rateDps;
+    if (s->axis == 0) s->roll += rateDps / RATE;
+    double r = s->roll * M_PI / 180.0;
+    double a[3] = { 0, sin(r), cos(r) + extraAz };
+
+    // Sideways mount: the board is turned 90 degrees about z, the roll shows up as pitch
+    if (s->sideways) {
+        double ax = a[0];
+        a[0] = -a[1];
+        a[1] = ax;
+        g[1] = g[0];
+        g[0] = 0;
+    }
+
+    imu_trace_record_t *rec = &t->records[t->count];
+    rec->seq = (uint8_t)t->count;
+    rec->dtUs = 1000000 / RATE;
+    for (int i = 0; i < 3; i++) {
+        rec->accel[i] = clamp16((a[i] + s->noiseG * normal()) * 4096);
+        rec->gyro[i] = clamp16((g[i] + s->noiseDps * normal()) * 131);
+    }
+    t->count++;
+}
+
+static void hold(synth_t *s, int ms) {
+    for (int i = 0; i < ms * RATE / 1000; i++) emit(s, 0, 0);
+}
+
+static void rotate(synth_t *s, double deg, int ms) {
+    int n = ms * RATE / 1000;
+    for (int i = 0; i < n; i++) emit(s, deg * RATE / n, 0);
+}
+
+static void label(trace_t *t, char symbol) {
+    if (t->labelCount < MAX_LABELS) {
+        t->labels[t->labelCount].time = (double)t->count / RATE;
+        t->labels[t->labelCount].symbol = symbol;
+        t->labelCount++;
+    }
+}
+
+// The guided mounting calibration (neutral, dot, dash, space) with the same mount and reach
+static void synthCalibration(trace_t *t, double angle, int sideways) {
+    static trace_t cal;
+    synth_t s = { &cal, 0, 0.01, 1.0, 0, sideways, 0, 0 };
+    cal.records = malloc(MAX_SAMPLES * sizeof(imu_trace_record_t));
+    cal.count = 0;
+    hold(&s, 1500);
+    rotate(&s, -angle, 500); hold(&s, 1500); rotate(&s, angle, 500);
+    rotate(&s, angle, 500); hold(&s, 1500); rotate(&s, -angle, 500);
+    for (int j = 0; j < 10; j++) emit(&s, 0, 0.6);
+    for (int j = 0; j < 10; j++) emit(&s, 0, -0.3);
+    hold(&s, 1500);
+    t->calRecords = cal.records;
+    t->calCount = cal.count;
+}
+
+// A random run of tilt gestures: turnMs to tilt by angle degrees, holdMs held there
+static void synthTilt(trace_t *t, const char *name, double angle, int turnMs, int holdMs, double noiseG,
+                      double noiseDps, double tremor, int sideways, uint32_t seed) {
+    synth_t s = { t, 0, noiseG, noiseDps, tremor, sideways, 0, 0 };
+    t->name = name;
+    t->mode = PIPELINE_TILT;
+    rng = seed;
+    hold(&s, 500);
+    for (int i = 0; i < 60; i++) {
+        double pick = uniform();
+        if (pick < 0.4) {
+            label(t, '.');
+            rotate(&s, -angle, turnMs); hold(&s, holdMs); rotate(&s, angle, turnMs);
+        }
+        else if (pick < 0.8) {
+            label(t, '-');
+            rotate(&s, angle, turnMs); hold(&s, holdMs); rotate(&s, -angle, turnMs);
+        }
+        else {
+            // Space: a quick up-down jerk
+            label(t, ' ');
+            for (int j = 0; j < 10; j++) emit(&s, 0, 0.6);
+            for (int j = 0; j < 10; j++) emit(&s, 0, -0.3);
+        }
+        hold(&s, 300 + (int)(uniform() * 400));
+    }
+    synthCalibration(t, angle, sideways);
+}
+
+// One dynamic gesture scaled in speed and size: a quick roll flick out and back ('.'),
+// a yaw twist out and back ('-') or a pitch shake of two swings (' ')
+static void flick(synth_t *s, char symbol, double speed, double size) {
+    int ms = (int)(120 / speed);
+    switch (symbol) {
+    case '.':
+        s->axis = 0;
+        rotate(s, 35 * size, ms); rotate(s, -35 * size, ms);
+        break;
+    case '-':
+        s->axis = 2;
+        rotate(s, 60 * size, ms); rotate(s, -60 * size, ms);
+        break;
+    default:
+        s->axis = 1;
+        for (int i = 0; i < 2; i++) {
+            rotate(s, 30 * size, ms / 2); rotate(s, -60 * size, ms); rotate(s, 30 * size, ms / 2);
+        }
+        break;
+    }
+    s->axis = 0;
+}
+
+// Dynamic gestures for the DTW templates: each is recorded once at nominal speed, then
+// performed 60 times with the speed and size varying by up to about 25 percent
+static void synthFlicks(trace_t *t, const char *name, double noiseDps, uint32_t seed) {
+    static const char symbols[] = ".- ";
+    synth_t s = { t, 0, 0.01, noiseDps, 0, 0, 0, 0 };
+    t->name = name;
+    t->mode = PIPELINE_TILT;
+    rng = seed;
+
+    for (int k = 0; k < 3; k++) {
+        static trace_t recording[3];
+        synth_t r = { &recording[k], 0, 0.01, noiseDps, 0, 0, 0, 0 };
+        recording[k].records = malloc(2000 * sizeof(imu_trace_record_t));
+        recording[k].count = 0;
+        hold(&r, 300);
+        flick(&r, symbols[k], 1, 1);
+        hold(&r, 500);
+        t->tplRecords[k] = recording[k].records;
+        t->tplCount[k] = recording[k].count;
+        t->tplSymbol[k] = symbols[k];
+    }
+    t->templates = 3;
+
+    hold(&s, 500);
+    for (int i = 0; i < 60; i++) {
+        char symbol = symbols[(int)(uniform() * 3)];
+        label(t, symbol);
+        flick(&s, symbol, 0.8 + uniform() * 0.45, 0.85 + uniform() * 0.3);
+        hold(&s, 400 + (int)(uniform() * 400));
+    }
+}
+
+// Straight-key tapping at a given dot length, impulses at key down and key up
+static void synthTap(trace_t *t, const char *name, int dotMs, uint32_t seed) {
+    synth_t s = { t, 0, 0.01, 1.0, 0, 0, 0, 0 };
+    t->name = name;
+    t->mode = PIPELINE_TAP;
+    rng = seed;
+    hold(&s, 500);
+    for (int i = 0; i < 60; i++) {
+        char symbol = uniform() < 0.5 ? '.' : '-';
+        int length = symbol == '.' ? dotMs : 3 * dotMs;
+        label(t, symbol);
+        emit(&s, 0, 0.8); emit(&s, 0, -0.5);
+        hold(&s, length - 10);
+        emit(&s, 0, 0.8); emit(&s, 0, -0.5);
+        hold(&s, dotMs - 10);
+        if (uniform() < 0.3) {
+            // End of letter: the keyer reports the gap after two dot lengths of silence
+            hold(&s, 2 * dotMs);
+            label(t, ' ');
+            hold(&s, dotMs);
+        }
+    }
+    hold(&s, 10 * dotMs);
+}
+
+static int loadTrace(trace_t *t, const char *path, const char *labelPath) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+        perror(path);
+        return -1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        fclose(file);
+        free(data);
+        return -1;
+    }
+    fclose(file);
+
+    // Only the first header is used, a recorded trace is benchmarked at one rate
+    int haveHeader = 0;
+    for (long pos = 0; pos < size && t->count < MAX_SAMPLES;) {
+        int n;
+        if (!haveHeader && (n = imu_trace_read_header(data + pos, size - pos, &t->header)) > 0) {
+            haveHeader = 1;
+        }
+        else if (haveHeader && (n = imu_trace_read_record(data + pos, size - pos, &t->records[t->count])) > 0) {
+            t->count++;
+        }
+        else {
+            n = 1;
+        }
+        pos += n;
+    }
+    free(data);
+
+    file = fopen(labelPath, "r");
+    if (file == NULL) {
+        perror(labelPath);
+        return -1;
+    }
+    double time;
+    char symbol;
+    while (t->labelCount < MAX_LABELS && fscanf(file, "%lf %c", &time, &symbol) == 2) {
+        t->labels[t->labelCount].time = time;
+        t->labels[t->labelCount].symbol = symbol == '_' ? ' ' : symbol;
+        t->labelCount++;
+    }
+    fclose(file);
+    t->name = path;
+    t->mode = PIPELINE_TILT;
+    return haveHeader ? 0 : -1;
+}
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Error against a double reference, maximum and RMS
+typedef struct {
+    double max, sum2;
+    int n;
+} error_t;
+
+static void error(error_t *e, double value, double reference) {
+    double d = fabs(value - reference);
+    if (d > e->max) e->max = d;
+    e->sum2 += d * d;
+    e->n++;
+}
+
+static volatile int64_t kernelSink;
+
+// symbols < 0 leaves the false_symbols column empty
+static void kernelRow(const char *kernel, const char *variant, const error_t *e, const char *unit,
+                      double elapsed, uint64_t cycleSum, double calls, int symbols) {
+    printf("%s,%s,%.3f,%.3f,%s,%.2f,%.1f,", kernel, variant, e->max, e->n ? sqrt(e->sum2 / e->n) : 0.0,
+           unit, elapsed * 1e9 / calls, cycleSum / calls);
+    if (symbols >= 0) printf("%d", symbols);
+    printf("\n");
+}
+
+// Raw sample to g and dps with the bias removed: the old float path subtracted a bias in g
+// after scaling, mpu9250_get_data_raw() subtracts it in counts and mpu9250_scale_q16() shifts
+static void benchScale(void) {
+    static int16_t raw[KERNEL_INPUTS][6];
+    const float aRes = 8.0f / 32768, gRes = 250.0f / 32768;
+    const int16_t biasRaw[3] = { 41, -73, 120 };
+    const float bias[3] = { 41 * aRes, -73 * aRes, 120 * aRes };
+    error_t eFloat = { 0 }, eQ16 = { 0 };
+
+    rng = 7;
+    for (int i = 0; i < KERNEL_INPUTS; i++) {
+        for (int j = 0; j < 6; j++) raw[i][j] = (int16_t)((uniform() - 0.5) * 60000);
+    }
+
+    // Accuracy in micro-dps against double, the accel scale is a power of two and exact in both
+    for (int i = 0; i < KERNEL_INPUTS; i++) {
+        for (int j = 3; j < 6; j++) {
+            double ref = raw[i][j] * 250.0 / 32768;
+            error(&eFloat, (float)raw[i][j] * gRes * 1e6, ref * 1e6);
+            error(&eQ16, (double)((int32_t)raw[i][j] * (500 << GSCALE)) / 65536 * 1e6, ref * 1e6);
+        }
+    }
+
+    float f[6];
+    double start = seconds();
+    uint64_t c0 = cycles();
+    for (int r = 0; r < KERNEL_ROUNDS; r++) {
+        for (int i = 0; i < KERNEL_INPUTS; i++) {
+            for (int j = 0; j < 3; j++) {
+                f[j] = (float)raw[i][j] * aRes - bias[j];
+                f[j + 3] = (float)raw[i][j + 3] * gRes;
+            }
+            kernelSink += (int64_t)(f[0] + f[1] + f[2] + f[3] + f[4] + f[5]);
+        }
+    }
+    kernelRow("scale", "float", &eFloat, "udps", seconds() - start, cycles() - c0,
+              (double)KERNEL_INPUTS * KERNEL_ROUNDS, -1);
+
+    int32_t q[6];
+    start = seconds();
+    c0 = cycles();
+    for (int r = 0; r < KERNEL_ROUNDS; r++) {
+        for (int i = 0; i < KERNEL_INPUTS; i++) {
+            for (int j = 0; j < 3; j++) {
+                int32_t v = (int32_t)raw[i][j] - biasRaw[j];
+                v = v > INT16_MAX ? INT16_MAX : v < INT16_MIN ? INT16_MIN : v;
+                q[j] = v << (ASCALE + 2);
+                q[j + 3] = (int32_t)raw[i][j + 3] * (500 << GSCALE);
+            }
+            kernelSink += q[0] + q[1] + q[2] + q[3] + q[4] + q[5];
+        }
+    }
+    kernelRow("scale", "q16", &eQ16, "udps", seconds() - start, cycles() - c0,
+              (double)KERNEL_INPUTS * KERNEL_ROUNDS, -1);
+}
+
+// Roll estimators on a device held near neutral while it is bumped sideways (1.8 g for
+// 250 ms, as when walking or swaying): accelerometer-only atan2 as the firmware
+// did before, the complementary filter in float, and the Q16 filter the pipeline runs.
+// Each roll also drives the gesture state machine; the trace has no gestures, so every
+// symbol it emits is false
+#define ORIENT_SECONDS  30
+
+static void benchOrientation(void) {
+    static int32_t accel[ORIENT_SECONDS * RATE][3], gyro[ORIENT_SECONDS * RATE][3];
+    static double truth[ORIENT_SECONDS * RATE];
+    const gesture_config_t config = GESTURE_CONFIG_DEFAULT;
+    const int n = ORIENT_SECONDS * RATE;
+    double roll = 0;
+
+    rng = 11;
+    for (int i = 0; i < n; i++) {
+        double rate = 20 * 2 * M_PI * 0.2 * cos(2 * M_PI * 0.2 * i / RATE);  // +-20 deg wander
+        double bump = i % RATE < RATE / 4 && (i / RATE) % 2 == 1 ? 1.8 : 0;
+        roll += rate / RATE;
+        truth[i] = roll;
+        double r = roll * M_PI / 180;
+        double a[3] = { 0, sin(r) + bump, cos(r) };
+        double g[3] = { rate, 0, 0 };
+        for (int j = 0; j < 3; j++) {
+            accel[i][j] = (int32_t)lround((a[j] + 0.01 * normal()) * 65536);
+            gyro[i][j] = (int32_t)lround((g[j] + 1.0 * normal()) * 65536);
+        }
+    }
+
+    for (int variant = 0; variant < 3; variant++) {
+        static const char *names[] = { "atan2_accel", "float", "q16" };
+        static double estimate[ORIENT_SECONDS * RATE];
+        orientation_t o;
+        gesture_t gesture;
+        error_t e = { 0 };
+        double start = 0, elapsed = 0;
+        uint64_t cycleSum = 0;
+        int symbols = 0;
+
+        // Timed over several passes, the estimates of the last one are scored
+        for (int pass = 0; pass < 8; pass++) {
+            float froll = 0;
+            int started = 0;
+            orientation_init(&o, RATE);
+            start = seconds();
+            uint64_t c0 = cycles();
+            for (int i = 0; i < n; i++) {
+                if (variant == 0) {
+                    estimate[i] = atan2(accel[i][1] / 65536.0, accel[i][2] / 65536.0) * 180 / M_PI;
+                }
+                else if (variant == 1) {
+                    float ay = accel[i][1] / 65536.0f, az = accel[i][2] / 65536.0f, ax = accel[i][0] / 65536.0f;
+                    float g2 = ax * ax + ay * ay + az * az;
+                    float accRoll = atan2f(ay, az) * (180 / (float)M_PI);
+                    if (!started) {
+                        froll = accRoll;
+                        started = 1;
+                    }
+                    else {
+                        froll += gyro[i][0] / 65536.0f / RATE;
+                        if (g2 >= 0.64f && g2 <= 1.44f) froll += (accRoll - froll) * 0.02f;
+                    }
+                    estimate[i] = froll;
+                }
+                else {
+                    orientation_update(&o, accel[i], gyro[i]);
+                    estimate[i] = o.roll / 1000.0;
+                }
+            }
+            cycleSum += cycles() - c0;
+            elapsed += seconds() - start;
+        }
+
+        gesture_init(&gesture, &config, RATE);
+        for (int i = 0; i < n; i++) {
+            error(&e, estimate[i], truth[i]);
+            gesture_update(&gesture, (int32_t)lround(estimate[i] * 1000), (int32_t)(accel[i][2] * 1000LL >> 16));
+            while (gesture_pop(&gesture) != 0) symbols++;
+        }
+        kernelRow("roll", names[variant], &e, "deg", elapsed, cycleSum, 8.0 * n, symbols);
+    }
+}
+
+// fix_atan2() and fix_sqrt() against libm on random vectors: half spread over the int32 range,
+// half of accelerometer size in Q10 g as the orientation filter passes them
+static void benchTrig(void) {
+    static int32_t y[KERNEL_INPUTS], x[KERNEL_INPUTS];
+    static uint32_t v[KERNEL_INPUTS];
+    error_t eLibm = { 0 }, eFix = { 0 };
+
+    rng = 13;
+    for (int i = 0; i < KERNEL_INPUTS; i++) {
+        double range = i % 2 ? 2147483647.0 : 2048.0;
+        y[i] = (int32_t)((uniform() * 2 - 1) * range);
+        x[i] = (int32_t)((uniform() * 2 - 1) * range);
+        v[i] = i % 2 ? (uint32_t)(uniform() * 4294967295.0) : (uint32_t)(uniform() * 4194304);
+    }
+
+    // Accuracy in mdeg, the double precision libm rows are the reference and show no error
+    for (int i = 0; i < KERNEL_INPUTS; i++) {
+        error(&eFix, fix_atan2(y[i], x[i]), atan2((double)y[i], (double)x[i]) * 180000 / M_PI);
+    }
+    double start = seconds();
+    uint64_t c0 = cycles();
+    for (int r = 0; r < KERNEL_ROUNDS; r++) {
+        for (int i = 0; i < KERNEL_INPUTS; i++) kernelSink += (int64_t)(atan2((double)y[i], (double)x[i]) * 180000 / M_PI);
+    }
+    kernelRow("atan2", "libm", &eLibm, "mdeg", seconds() - start, cycles() - c0, (double)KERNEL_INPUTS * KERNEL_ROUNDS, -1);
+    start = seconds();
+    c0 = cycles();
+    for (int r = 0; r < KERNEL_ROUNDS; r++) {
+        for (int i = 0; i < KERNEL_INPUTS; i++) kernelSink += fix_atan2(y[i], x[i]);
+    }
+    kernelRow("atan2", "fix", &eFix, "mdeg", seconds() - start, cycles() - c0, (double)KERNEL_INPUTS * KERNEL_ROUNDS, -1);
+
+    // Square root in units of the result, against the exact root (fix_sqrt floors it)
+    error_t eFixSqrt = { 0 };
+    for (int i = 0; i < KERNEL_INPUTS; i++) {
+        error(&eFixSqrt, fix_sqrt(v[i]), sqrt((double)v[i]));
+    }
+    start = seconds();
+    c0 = cycles();
+    for (int r = 0; r < KERNEL_ROUNDS; r++) {
+        for (int i = 0; i < KERNEL_INPUTS; i++) kernelSink += (int64_t)sqrt((double)v[i]);
+    }
+    kernelRow("sqrt", "libm", &eLibm, "lsb", seconds() - start, cycles() - c0, (double)KERNEL_INPUTS * KERNEL_ROUNDS, -1);
+    start = seconds();
+    c0 = cycles();
+    for (int r = 0; r < KERNEL_ROUNDS; r++) {
+        for (int i = 0; i < KERNEL_INPUTS; i++) kernelSink += fix_sqrt(v[i]);
+    }
+    kernelRow("sqrt", "fix", &eFixSqrt, "lsb", seconds() - start, cycles() - c0, (double)KERNEL_INPUTS * KERNEL_ROUNDS, -1);
+
+    // fix_sqrt() floors, check that it is exactly the floor everywhere it was sampled
+    for (int i = 0; i < KERNEL_INPUTS; i++) {
+        uint32_t r = fix_sqrt(v[i]);
+        if ((uint64_t)r * r > v[i] || (uint64_t)(r + 1) * (r + 1) <= v[i]) {
+            printf("sqrt,fix,not the floor of sqrt(%u): %u\n", v[i], r);
+        }
+    }
+}
+
+static int kernels(void) {
+    printf("kernel,variant,max_error,rms_error,error_unit,ns_per_call,cycles_per_call,false_symbols\n");
+    benchScale();
+    benchTrig();
+    benchOrientation();
+    return 0;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+static void run(const detector_t *det, const trace_t *t) {
+    static pipeline_t pipeline;
+    gesture_config_t gestureConfig = det->gesture;
+    tapkey_config_t tapConfig = TAPKEY_CONFIG_DEFAULT;
+    int matched[MAX_LABELS] = { 0 };
+    double latency[MAX_LABELS];
+    int detections = 0, tp = 0, fp = 0;
+    double timeUs = 0;
+    uint64_t cycleSum = 0;
+
+    pipeline_init(&pipeline, &gestureConfig, &tapConfig, t->header.rate);
+    pipeline_set_mode(&pipeline, det->mode);
+
+    // Calibration samples are not scored, the learned thresholds replace the detector's
+    if (det->calibrate) {
+        pipeline_calibrate_mount(&pipeline);
+        for (int i = 0; i < t->calCount; i++) {
+            int32_t accel[3], gyro[3];
+            imu_trace_scale_q16(&t->header, &t->calRecords[i], accel, gyro);
+            pipeline_update(&pipeline, accel, gyro);
+        }
+        mount_gesture_config(&pipeline.mount, &det->gesture, &gestureConfig);
+    }
+
+    // Template recordings are not scored either, each ends once the device is still again
+    if (det->record) {
+        for (int k = 0; k < t->templates; k++) {
+            dtw_record(&pipeline.dtw, k, t->tplSymbol[k]);
+            for (int i = 0; i < t->tplCount[k]; i++) {
+                int32_t accel[3], gyro[3];
+                imu_trace_scale_q16(&t->header, &t->tplRecords[k][i], accel, gyro);
+                pipeline_update(&pipeline, accel, gyro);
+            }
+        }
+    }
+
+    for (int i = 0; i < t->count; i++) {
+        int32_t accel[3], gyro[3];
+        imu_trace_scale_q16(&t->header, &t->records[i], accel, gyro);
+        timeUs += t->records[i].dtUs;
+
+        uint64_t c0 = cycles();
+        pipeline_update(&pipeline, accel, gyro);
+        cycleSum += cycles() - c0;
+
+        // Greedy in order: a detection matches the earliest open label with its symbol in the window
+        char symbol;
+        while ((symbol = pipeline_pop(&pipeline)) != 0) {
+            double now = timeUs / 1e6;
+            int hit = -1;
+            detections++;
+            for (int l = 0; l < t->labelCount; l++) {
+                if (!matched[l] && t->labels[l].symbol == symbol && t->labels[l].time <= now
+                        && now - t->labels[l].time <= MATCH_WINDOW) {
+                    hit = l;
+                    break;
+                }
+            }
+            if (hit >= 0) {
+                matched[hit] = 1;
+                latency[tp++] = now - t->labels[hit].time;
+            }
+            else {
+                fp++;
+            }
+        }
+    }
+
+    int fn = t->labelCount - tp;
+    double sum = 0;
+    for (int i = 0; i < tp; i++) sum += latency[i];
+    qsort(latency, tp, sizeof(double), compareDouble);
+
+    printf("%s,%s,%d,%d,%d,%d,%d,%.3f,%.3f,%.0f,%.0f,%.0f\n",
+           det->name, t->name, t->labelCount, detections, tp, fp, fn,
+           detections ? (double)tp / detections : 0.0,
+           t->labelCount ? (double)tp / t->labelCount : 0.0,
+           tp ? sum * 1000 / tp : 0.0,
+           tp ? latency[(tp * 95 - 1) / 100] * 1000 : 0.0,
+           t->count ? (double)cycleSum / t->count : 0.0);
+}
+
+int main(int argc, char *argv[]) {
+    // The thresholds the two main files used before the gesture state machine, and the current default
+    detector_t detectors[8] = {
+        { "default", GESTURE_CONFIG_DEFAULT, PIPELINE_TILT, 0, 0 },
+        { "calibrated", GESTURE_CONFIG_DEFAULT, PIPELINE_TILT, 1, 0 },
+        { "dtw", GESTURE_CONFIG_DEFAULT, PIPELINE_TILT, 0, 1 },
+        { "legacy_csproject", { 60000, 60000, 120000, 60000, 1250, 1250, 0, 0, 0 }, PIPELINE_TILT, 0, 0 },
+        { "legacy_root", { 80000, 80000, 100000, 80000, 1700, 1700, 0, 0, 0 }, PIPELINE_TILT, 0, 0 },
+        { "tap", GESTURE_CONFIG_DEFAULT, PIPELINE_TAP, 0, 0 },
+    };
+    int detectorCount = 6;
+    static trace_t traces[16];
+    int traceCount = 0;
+
+    if (argc == 2 && strcmp(argv[1], "-k") == 0) {
+        return kernels();
+    }
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-g") == 0 && i + 3 < argc && detectorCount < 8) {
+            detector_t *d = &detectors[detectorCount++];
+            *d = detectors[0];
+            d->name = "custom";
+            d->gesture.rollEnter = atoi(argv[++i]) * 1000;
+            d->gesture.rollExit = atoi(argv[++i]) * 1000;
+            d->gesture.dwellMs = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "-t") == 0 && i + 2 < argc && traceCount < 16) {
+            trace_t *t = &traces[traceCount];
+            t->records = malloc(MAX_SAMPLES * sizeof(imu_trace_record_t));
+            if (loadTrace(t, argv[i + 1], argv[i + 2]) == 0) traceCount++;
+            i += 2;
+        }
+        else {
+            printf("Usage: %s [-g <enter deg> <exit deg> <dwell ms>] [-t <trace> <labels>]...\n"
+                   "       %s -k\n", argv[0], argv[0]);
+            return 1;
+        }
+    }
+
+    // Synthetic scenarios with fixed seeds
+    const imu_trace_header_t header = { IMU_TRACE_VERSION, ASCALE, GSCALE, RATE };
+    for (int i = 0; i < 8 && traceCount < 16; i++) {
+        trace_t *t = &traces[traceCount++];
+        t->header = header;
+        t->records = malloc(MAX_SAMPLES * sizeof(imu_trace_record_t));
+        switch (i) {
+        case 0: synthTilt(t, "slow", 90, 900, 600, 0.01, 1.0, 0, 0, 1); break;
+        case 1: synthTilt(t, "fast", 90, 400, 150, 0.01, 1.0, 0, 0, 2); break;
+        case 2: synthTilt(t, "noisy", 90, 500, 300, 0.08, 15.0, 3, 0, 3); break;
+        case 3: synthTilt(t, "shallow_tremor", 68, 500, 400, 0.02, 2.0, 6, 0, 4); break;
+        case 4: synthTilt(t, "sideways", 90, 500, 300, 0.01, 1.0, 0, 1, 5); break;
+        case 5: synthTap(t, "tap_12wpm", 100, 6); break;
+        case 6: synthFlicks(t, "flicks", 1.0, 7); break;
+        case 7: synthFlicks(t, "flicks_noisy", 8.0, 8); break;
+        }
+    }
+
+    printf("detector,trace,labels,detections,tp,fp,fn,precision,recall,latency_ms_avg,latency_ms_p95,cycles_per_sample\n");
+    for (int d = 0; d < detectorCount; d++) {
+        for (int t = 0; t < traceCount; t++) {
+            if (traces[t].mode == detectors[d].mode && (!detectors[d].calibrate || traces[t].calCount > 0)
+                    && (!detectors[d].record || traces[t].templates > 0)) {
+                run(&detectors[d], &traces[t]);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,161 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "motion/imu_trace.h"
+#include "motion/pipeline.h"
+#include "morse/morse.h"
+
+// Replays an IMU trace captured with "#capture on" through the same gesture pipeline
+// as the SensorTag, as fast as the host allows. The pipeline is integer only, so a
+// trace always produces the same symbols.
+// Build: gcc -O2 -ICSProject imu_replay.c CSProject/motion/*.c CSProject/morse/morse.c -o imu_replay
+// Usage: imu_replay <trace> [tilt|tap] [-g <enter deg> <exit deg> <dwell ms>]
+
+// Gyro below this on every axis counts as still, motion onset is the first sample after stillness
+#define STILL_DPS  10
+
+static uint64_t cycles(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return 0;
+#endif
+}
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 2) {
+        printf("Usage: %s <trace> [tilt|tap] [-g <enter deg> <exit deg> <dwell ms>]\n", argv[0]);
+        return 1;
+    }
+
+    gesture_config_t gestureConfig = GESTURE_CONFIG_DEFAULT;
+    tapkey_config_t tapConfig = TAPKEY_CONFIG_DEFAULT;
+    pipeline_mode_t mode = PIPELINE_TILT;
+    for (int i = 2; i < argc; i++) {
+        if (strcmp(argv[i], "tap") == 0) mode = PIPELINE_TAP;
+        else if (strcmp(argv[i], "-g") == 0 && i + 3 < argc) {
+            gestureConfig.rollEnter = atoi(argv[++i]) * 1000;
+            gestureConfig.rollExit = atoi(argv[++i]) * 1000;
+            gestureConfig.dwellMs = atoi(argv[++i]);
+        }
+    }
+
+    // The whole trace is loaded first so file I/O stays out of the timing
+    FILE *file = fopen(argv[1], "rb");
+    if (file == NULL) {
+        perror(argv[1]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = malloc(size > 0 ? size : 1);
+    if (data == NULL || fread(data, 1, size, file) != (size_t)size) {
+        printf("Error reading %s\n", argv[1]);
+        return 1;
+    }
+    fclose(file);
+
+    pipeline_t pipeline;
+    imu_trace_header_t header;
+    int haveHeader = 0;
+    morse_decoder_t decoder;
+    morse_decoder_init(&decoder);
+
+    char text[4096];
+    size_t textLength = 0;
+    unsigned long samples = 0, lost = 0, skipped = 0, symbols = 0;
+    uint64_t traceUs = 0, onsetUs = 0, latencySum = 0, latencyMax = 0;
+    uint64_t cycleSum = 0;
+    int still = 1;
+    uint8_t nextSeq = 0;
+    double start = seconds();
+
+    long pos = 0;
+    while (pos < size) {
+        imu_trace_record_t record;
+        int n;
+
+        if ((n = imu_trace_read_header(data + pos, size - pos, &header)) > 0) {
+            if (!haveHeader) {
+                pipeline_init(&pipeline, &gestureConfig, &tapConfig, header.rate);
+                pipeline_set_mode(&pipeline, mode);
+            }
+            else {
+                pipeline_set_rate(&pipeline, header.rate);
+            }
+            haveHeader = 1;
+            pos += n;
+            continue;
+        }
+        if (!haveHeader || (n = imu_trace_read_record(data + pos, size - pos, &record)) == 0) {
+            // Not a header or a valid record, e.g. a command reply in the stream
+            skipped++;
+            pos++;
+            continue;
+        }
+        pos += n;
+
+        if (samples > 0) {
+            lost += (uint8_t)(record.seq - nextSeq);
+        }
+        nextSeq = record.seq + 1;
+        traceUs += record.dtUs;
+        samples++;
+
+        int32_t accel[3], gyro[3];
+        imu_trace_scale_q16(&header, &record, accel, gyro);
+
+        int moving = 0;
+        for (int i = 0; i < 3; i++) {
+            if (gyro[i] > (STILL_DPS << 16) || gyro[i] < -(STILL_DPS << 16)) moving = 1;
+        }
+        if (moving && still) onsetUs = traceUs;
+        still = !moving;
+
+        uint64_t c0 = cycles();
+        pipeline_update(&pipeline, accel, gyro);
+        cycleSum += cycles() - c0;
+
+        char symbol;
+        while ((symbol = pipeline_pop(&pipeline)) != 0) {
+            uint64_t latency = traceUs - onsetUs;
+            latencySum += latency;
+            if (latency > latencyMax) latencyMax = latency;
+            symbols++;
+            printf("%10.3f s  '%c'  %5.0f ms after motion onset\n", traceUs / 1e6, symbol, latency / 1e3);
+
+            char c = morse_decoder_feed(&decoder, symbol);
+            if (c && textLength < sizeof(text) - MORSE_SPELL_MAX) textLength += morse_spell(c, text + textLength);
+        }
+    }
+    char c = morse_decoder_feed(&decoder, ' ');
+    if (c && textLength < sizeof(text) - MORSE_SPELL_MAX) textLength += morse_spell(c, text + textLength);
+    text[textLength] = '\0';
+
+    double elapsed = seconds() - start;
+    printf("\nText: %s\n", text);
+    printf("Samples: %lu (%lu lost in capture, %lu bytes skipped), trace %.1f s\n",
+           samples, lost, skipped, traceUs / 1e6);
+    printf("Symbols: %lu, latency from motion onset avg %.0f ms max %.0f ms\n",
+           symbols, symbols ? latencySum / 1e3 / symbols : 0.0, latencyMax / 1e3);
+    if (samples > 0) {
+        printf("Replay: %.3f s, %.0fx real time, %.0f ns and %.0f cycles per sample\n",
+               elapsed, elapsed > 0 ? traceUs / 1e6 / elapsed : 0.0,
+               elapsed * 1e9 / samples, (double)cycleSum / samples);
+    }
+
+    free(data);
+    return 0;
+}
@@ -1,52 +1,239 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-// Define Morse code mappings
-typedef struct {
-    char character;
-    char *morse;
-} MorseCode;
-
-MorseCode morseTable[] = {
-    {'A', ".-"}, {'B', "-..."}, {'C', "-.-."}, {'D', "-.."}, {'E', "."},
-    {'F', "..-."}, {'G', "--."}, {'H', "...."}, {'I', ".."}, {'J', ".---"},
-    {'K', "-.-"}, {'L', ".-.."}, {'M', "--"}, {'N', "-."}, {'O', "---"},
-    {'P', ".--."}, {'Q', "--.-"}, {'R', ".-."}, {'S', "..."}, {'T', "-"},
-    {'U', "..-"}, {'V', "...-"}, {'W', ".--"}, {'X', "-..-"}, {'Y', "-.--"},
-    {'Z', "--.."}, {'1', ".----"}, {'2', "..---"}, {'3', "...--"}, {'4', "....-"},
-    {'5', "....."}, {'6', "-...."}, {'7', "--..."}, {'8', "---.."}, {'9', "----."},
-    {'0', "-----"}
-};
-
-// Function to decode a single Morse code symbol
-char morseToLetter(char *morse) {
-    int comparison;
-    for (int i = 0; i < sizeof(morseTable) / sizeof(MorseCode); i++) {
-        comparison = strcmp(morse, morseTable[i].morse);
-        if(comparison == 0) return morseTable[i].character;
+#include "morse/morse.h"
+
+// Morse table and decoder are shared with the SensorTag firmware so both decode identically.
+// Input is streamed in chunks through the decoder state machine, a letter split across two
+// reads decodes the same, so input of any size runs in CHUNK_SIZE of memory. A newline ends
+// the word and is copied to the output. Throughput is reported on stderr.
+// Build: gcc -O2 -ICSProject morse_decoder.c CSProject/morse/morse.c -o morse_decoder
+// Usage: morse_decoder [-m] [file...]   decode stdin or the files, -m maps files instead of reading
+//        morse_decoder -b               benchmark the table lookup against the old strcmp scan
+
+#define CHUNK_SIZE     (1 << 20)
+#define MAP_WINDOW     (64 << 20)  // Multiple of the page size
+#define BENCH_LETTERS  2000000
+
+static char outBuffer[CHUNK_SIZE];
+static size_t outLength = 0;
+
+static void put(char c) {
+    if (outLength == sizeof(outBuffer)) {
+        fwrite(outBuffer, 1, outLength, stdout);
+        outLength = 0;
+    }
+    outBuffer[outLength++] = c;
+}
+
+// Accented letters and prosigns are written out as UTF-8 or "<SK>"
+static void putSpelled(char c) {
+    if ((unsigned char)c < MORSE_EXTENDED) {
+        put(c);
+        return;
+    }
+    char spelled[MORSE_SPELL_MAX];
+    int n = morse_spell(c, spelled);
+    for (int i = 0; i < n; i++) put(spelled[i]);
+}
+
+static void flush(void) {
+    fwrite(outBuffer, 1, outLength, stdout);
+    fflush(stdout);
+    outLength = 0;
+}
+
+static void decode(morse_decoder_t *decoder, const char *data, size_t length) {
+    for (size_t i = 0; i < length; i++) {
+        char c;
+        if (data[i] == '\n') {
+            // End the letter and the word, the line break stands in for the word space
+            c = morse_decoder_feed(decoder, ' ');
+            if (c && c != ' ') putSpelled(c);
+            morse_decoder_feed(decoder, ' ');
+            put('\n');
+        }
+        else if ((c = morse_decoder_feed(decoder, data[i])) != 0) {
+            putSpelled(c);
+        }
+    }
+}
+
+// Read a stream in chunks, returns the bytes read or -1
+static long long decodeStream(morse_decoder_t *decoder, int fd) {
+    static char chunk[CHUNK_SIZE];
+    long long total = 0;
+    int interactive = isatty(fd);
+    ssize_t n;
+
+    while ((n = read(fd, chunk, sizeof(chunk))) > 0) {
+        decode(decoder, chunk, n);
+        total += n;
+        if (interactive) flush();
+    }
+    return n < 0 ? -1 : total;
+}
+
+// Map a regular file window by window and decode it in place, so resident memory stays at one
+// window however large the file is. Falls back to reading for pipes and empty files
+static long long decodeMapped(morse_decoder_t *decoder, int fd) {
+    struct stat st;
+
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0) {
+        return decodeStream(decoder, fd);
+    }
+    for (off_t offset = 0; offset < st.st_size; offset += MAP_WINDOW) {
+        size_t length = st.st_size - offset < MAP_WINDOW ? (size_t)(st.st_size - offset) : MAP_WINDOW;
+        char *data = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, offset);
+        if (data == MAP_FAILED) {
+            return -1;
+        }
+        madvise(data, length, MADV_SEQUENTIAL);
+        decode(decoder, data, length);
+        munmap(data, length);
+    }
+    return st.st_size;
+}
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// The decoder this tool had before the shared table: strcmp against every code in turn
+static char linearTable[36][8];
+static char linearCharacters[36];
+static int linearSize;
+
+static char morseToLetter(const char *morse) {
+    for (int i = 0; i < linearSize; i++) {
+        if (strcmp(morse, linearTable[i]) == 0) return linearCharacters[i];
     }
     return '?';
 }
 
-int main() {
-    char input[1000];
-    printf("Enter Morse code (use spaces to separate symbols): ");
-    fgets(input, sizeof(input), stdin);
-    
-    size_t len = strlen(input);
-    if (len > 0 && input[len - 1] == '\n') {
-        input[len - 1] = '\0';
+// Unpack a code after the leading 1 bit into '.' and '-'
+static void unpack(uint16_t code, char *morse) {
+    int length = 0;
+    while ((code >> (length + 1)) != 0) length++;
+    for (int i = 0; i < length; i++) {
+        morse[i] = (code >> (length - 1 - i)) & 1 ? '-' : '.';
+    }
+    morse[length] = '\0';
+}
+
+static int bench(void) {
+    const char *characters = "ABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    linearSize = (int)strlen(characters);
+    for (int i = 0; i < linearSize; i++) {
+        linearCharacters[i] = characters[i];
+        unpack(morse_encode(characters[i]), linearTable[i]);
+    }
+
+    // Random letters as a symbol stream, one space after each
+    char *stream = malloc(BENCH_LETTERS * 7);
+    size_t length = 0;
+    unsigned int seed = 1;
+    for (int i = 0; i < BENCH_LETTERS; i++) {
+        seed = seed * 1103515245 + 12345;
+        const char *m = linearTable[(seed >> 16) % linearSize];
+        while (*m) stream[length++] = *m++;
+        stream[length++] = ' ';
+    }
+
+    // Before: tokenize each letter and scan the table
+    unsigned long check = 0;
+    char token[8];
+    size_t t = 0;
+    double start = seconds();
+    for (size_t i = 0; i < length; i++) {
+        if (stream[i] == ' ') {
+            token[t] = '\0';
+            check += morseToLetter(token);
+            t = 0;
+        }
+        else if (t < sizeof(token) - 1) {
+            token[t++] = stream[i];
+        }
+    }
+    double linear = seconds() - start;
+
+    // After: the shared decoder, one table load per letter
+    morse_decoder_t decoder;
+    unsigned long check2 = 0;
+    morse_decoder_init(&decoder);
+    start = seconds();
+    for (size_t i = 0; i < length; i++) {
+        check2 += morse_decoder_feed(&decoder, stream[i]);
+    }
+    double table = seconds() - start;
+
+    printf("%lu symbols, %d letters\n", (unsigned long)length, BENCH_LETTERS);
+    printf("strcmp scan:  %6.1f M symbols/s\n", length / linear / 1e6);
+    printf("table lookup: %6.1f M symbols/s (%.1fx)\n", length / table / 1e6, linear / table);
+    free(stream);
+    return check == check2 ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "-b") == 0) {
+        return bench();
     }
 
-    char *token = strtok(input, " ");
-    while (token != NULL) {
-        printf("%c", morseToLetter(token));
-        token = strtok(NULL, " ");
-        if (token != NULL && *token == '\0') {
-            printf(" ");
-            token = strtok(NULL, " ");
+    int mapped = 0, files = 0, status = 0;
+    long long total = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-m") == 0) mapped = 1;
+        else files++;
+    }
+    if (files == 0 && isatty(STDIN_FILENO)) {
+        printf("Enter Morse code (use spaces to separate symbols, Ctrl-D to end): ");
+        fflush(stdout);
+    }
+
+    // One space ends a letter, two end a word, the same as the symbols the SensorTag sends.
+    // The decoder carries over from one file to the next like one stream
+    morse_decoder_t decoder;
+    morse_decoder_init(&decoder);
+    double start = seconds();
+    for (int i = 1; i <= argc; i++) {
+        int fd;
+        if (i == argc) {
+            if (files > 0) break;
+            fd = STDIN_FILENO;
+        }
+        else if (strcmp(argv[i], "-m") == 0) {
+            continue;
+        }
+        else if ((fd = open(argv[i], O_RDONLY)) < 0) {
+            perror(argv[i]);
+            status = 1;
+            continue;
+        }
+
+        long long n = mapped ? decodeMapped(&decoder, fd) : decodeStream(&decoder, fd);
+        if (n < 0) {
+            perror(i == argc ? "stdin" : argv[i]);
+            status = 1;
+        }
+        else {
+            total += n;
         }
+        if (fd != STDIN_FILENO) close(fd);
     }
+    char c = morse_decoder_feed(&decoder, ' ');
+    if (c && c != ' ') putSpelled(c);
+    if (outLength == 0 || outBuffer[outLength - 1] != '\n') put('\n');
+    flush();
 
-    return 0;
+    double elapsed = seconds() - start;
+    fprintf(stderr, "%lld bytes in %.3f s, %.1f MB/s\n", total, elapsed, elapsed > 0 ? total / elapsed / 1e6 : 0.0);
+    return status;
 }
@@ -0,0 +1,152 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "morse/morse.h"
+
+// Text to Morse with the encoder the SensorTag uses for "#text". Prints the symbols the
+// decoder reads ('.', '-', one space after a letter, two after a word) with each input line
+// on its own line, so morse_encoder | morse_decoder gives the text back in upper case.
+// Prosigns are written in angle brackets like <SK>, accented letters in UTF-8. With
+// -e it prints the timed key events instead, "on <ms>" or "off <ms>" per line at the given
+// dot length. Input is read in chunks, throughput is reported on stderr.
+// Build: gcc -O2 -ICSProject morse_encoder.c CSProject/morse/morse.c -o morse_encoder
+// Usage: morse_encoder [-e <dot ms>] [file...]
+
+#define CHUNK_SIZE  (1 << 20)
+
+static char outBuffer[CHUNK_SIZE];
+static size_t outLength = 0;
+static int eventUnitMs = 0;
+
+static void flush(void) {
+    fwrite(outBuffer, 1, outLength, stdout);
+    outLength = 0;
+}
+
+// Drain the encoder into the output buffer
+static void drain(morse_encoder_t *encoder) {
+    if (eventUnitMs > 0) {
+        morse_event_t events[256];
+        int n;
+        while ((n = morse_encode_events(encoder, events, 256)) > 0) {
+            for (int i = 0; i < n; i++) {
+                if (outLength + 32 > sizeof(outBuffer)) flush();
+                outLength += sprintf(outBuffer + outLength, "%s %d\n", events[i].on ? "on" : "off",
+                                     events[i].units * eventUnitMs);
+            }
+        }
+        return;
+    }
+    for (;;) {
+        if (sizeof(outBuffer) - outLength < 64) flush();
+        int n = morse_encode_symbols(encoder, outBuffer + outLength, sizeof(outBuffer) - outLength);
+        if (n == 0) break;
+        outLength += n;
+    }
+}
+
+// Encode a chunk line by line, a line break ends the last letter and is copied through
+static void encode(morse_encoder_t *encoder, const char *data, size_t length) {
+    while (length > 0) {
+        const char *newline = memchr(data, '\n', length);
+        size_t line = newline ? (size_t)(newline - data) : length;
+
+        morse_encoder_input(encoder, data, line);
+        drain(encoder);
+        if (newline) {
+            morse_event_t event;
+            if (eventUnitMs == 0) {
+                if (outLength + 2 > sizeof(outBuffer)) flush();
+                if (morse_encoder_end(encoder, &event)) outBuffer[outLength++] = ' ';
+                outBuffer[outLength++] = '\n';
+                morse_encoder_init(encoder);
+            }
+            else {
+                // Events keep the word gap across lines
+                morse_encoder_input(encoder, "\n", 1);
+                drain(encoder);
+            }
+            line++;
+        }
+        data += line;
+        length -= line;
+    }
+}
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+    static char chunk[CHUNK_SIZE];
+    int first = 1, status = 0;
+    long long total = 0;
+
+    if (argc > 2 && strcmp(argv[1], "-e") == 0) {
+        eventUnitMs = atoi(argv[2]);
+        if (eventUnitMs <= 0) {
+            printf("Usage: %s [-e <dot ms>] [file...]\n", argv[0]);
+            return 1;
+        }
+        first = 3;
+    }
+
+    morse_encoder_t encoder;
+    morse_encoder_init(&encoder);
+    double start = seconds();
+    for (int i = first; i <= argc; i++) {
+        int fd;
+        if (i == argc) {
+            if (argc > first) break;
+            fd = STDIN_FILENO;
+        }
+        else if ((fd = open(argv[i], O_RDONLY)) < 0) {
+            perror(argv[i]);
+            status = 1;
+            continue;
+        }
+
+        // Whole lines are encoded and the unfinished one is kept, so a prosign or UTF-8
+        // letter is never split between two reads
+        ssize_t n;
+        size_t kept = 0;
+        while ((n = read(fd, chunk + kept, sizeof(chunk) - kept)) > 0) {
+            size_t length = kept + n, done = length;
+            while (done > 0 && chunk[done - 1] != '\n') done--;
+            if (done == 0) done = length;
+            encode(&encoder, chunk, done);
+            kept = length - done;
+            memmove(chunk, chunk + done, kept);
+            total += n;
+            if (isatty(fd)) {
+                flush();
+                fflush(stdout);
+            }
+        }
+        encode(&encoder, chunk, kept);
+        if (n < 0) {
+            perror(i == argc ? "stdin" : argv[i]);
+            status = 1;
+        }
+        if (fd != STDIN_FILENO) close(fd);
+    }
+
+    // End the last letter, unless the input ended with a line break that already did
+    morse_event_t event;
+    if (morse_encoder_end(&encoder, &event)) {
+        if (eventUnitMs > 0) outLength += sprintf(outBuffer + outLength, "off %d\n", event.units * eventUnitMs);
+        else outLength += sprintf(outBuffer + outLength, " \n");
+    }
+    flush();
+    fflush(stdout);
+
+    double elapsed = seconds() - start;
+    fprintf(stderr, "%lld bytes in %.3f s, %.1f MB/s\n", total, elapsed, elapsed > 0 ? total / elapsed / 1e6 : 0.0);
+    return status;
+}
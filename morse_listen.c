@@ -0,0 +1,357 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include "morse/morse.h"
+
+// Live decoder for the tag's UART stream. The root project_main.c sends one symbol per line
+// (".\r\n", "-\r\n", " \r\n"): symbols are reassembled as they arrive and every letter is
+// printed the moment its letter gap is read. CSProject decodes on the tag and sends each word
+// as a line of text, those are printed one per line with the seconds since the first byte.
+// Word lines have no spaces, telemetry and command replies always do: they are skipped, or
+// echoed to stderr with -v. A lone "." or "-" is read as a symbol until the first word line.
+// On exit (end of file, the tty closing or Ctrl-C) it prints per-letter latency: from reading
+// the letter gap to printing the letter, and with -w from the scripted writer sending the gap,
+// i.e. through the pseudo-terminal. Exits non-zero when nothing decodable arrived.
+// Build: gcc -O2 -ICSProject morse_listen.c CSProject/morse/morse.c -o morse_listen
+// Usage: morse_listen [-v] [-b <baud>] <tty or file>
+//        morse_listen [-v] -p [-w <text> <dot ms>]
+//   -p listens on a new pseudo-terminal and prints its name, anything can write the tag's
+//   stream into it. -w forks a writer that keys the text into it with the tag's timing.
+
+#define MAX_LATENCIES  100000
+#define MAX_LETTERS    4096
+#define LINE_MAX_BYTES 256
+
+static volatile sig_atomic_t stop = 0;
+
+static void onSignal(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void sleepUntil(double t) {
+    double now = seconds();
+    if (t > now) {
+        struct timespec ts = { (time_t)(t - now), (long)((t - now - (time_t)(t - now)) * 1e9) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+static speed_t baudRate(int baud) {
+    switch (baud) {
+    case 9600: return B9600;
+    case 19200: return B19200;
+    case 38400: return B38400;
+    case 57600: return B57600;
+    case 115200: return B115200;
+    default: return 0;
+    }
+}
+
+// Key the text in as the tag does: a symbol line when an element ends, a space line when
+// a letter gap has passed and a second one after a word gap. Records the time of the first
+// max letter gaps relative to start, and only records when fd < 0. Returns all letters
+static int script(const char *text, int dotMs, double start, int fd, double *gapTimes, int max) {
+    morse_encoder_t encoder;
+    morse_event_t event;
+    double t = 0, dot = dotMs / 1000.0;
+    int letters = 0;
+
+    morse_encoder_init(&encoder);
+    morse_encoder_input(&encoder, text, strlen(text));
+    for (;;) {
+        int more = morse_encoder_next(&encoder, &event);
+        if (!more && !morse_encoder_end(&encoder, &event)) break;
+
+        if (event.on) {
+            t += event.units * dot;
+            if (fd >= 0) {
+                sleepUntil(start + t);
+                if (write(fd, event.units == 1 ? ".\r\n" : "-\r\n", 3) < 0) return -1;
+            }
+        }
+        else if (event.units == 1) {
+            t += dot;
+        }
+        else {
+            // The letter gap is recognized after 3 dots of silence, a word gap after 7
+            if (letters < max) gapTimes[letters] = t + 3 * dot;
+            letters++;
+            if (fd >= 0) {
+                sleepUntil(start + t + 3 * dot);
+                if (write(fd, " \r\n", 3) < 0) return -1;
+            }
+            if (event.units == 7 && fd >= 0) {
+                sleepUntil(start + t + 7 * dot);
+                if (write(fd, " \r\n", 3) < 0) return -1;
+            }
+            t += event.units * dot;
+        }
+    }
+    return letters;
+}
+
+static int compareDouble(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+// A line of only '.', '-' and ' ' carries symbols, a line of spaces is one gap per space
+static int symbolLine(const char *line, int length) {
+    if (length == 0) return 0;
+    for (int i = 0; i < length; i++) {
+        if (line[i] != '.' && line[i] != '-' && line[i] != ' ') return 0;
+    }
+    return 1;
+}
+
+// A word decoded on the tag: printable, no spaces
+static int wordLine(const char *line, int length) {
+    if (length == 0) return 0;
+    for (int i = 0; i < length; i++) {
+        if ((unsigned char)line[i] <= ' ' || line[i] == 0x7F) return 0;
+    }
+    return 1;
+}
+
+// Letters in a word line: prosigns are spelled "<SK>" and accented letters take two UTF-8 bytes
+static int wordLetters(const char *line, int length) {
+    int letters = 0;
+    for (int i = 0; i < length; i++) {
+        if (line[i] == '<') {
+            while (i + 1 < length && line[i] != '>') i++;
+        }
+        else if (((unsigned char)line[i] & 0xC0) == 0x80) {
+            continue;
+        }
+        letters++;
+    }
+    return letters;
+}
+
+int main(int argc, char *argv[]) {
+    const char *path = NULL, *scriptText = NULL;
+    int verbose = 0, pty = 0, baud = 9600, dotMs = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) verbose = 1;
+        else if (strcmp(argv[i], "-p") == 0) pty = 1;
+        else if (strcmp(argv[i], "-b") == 0 && i + 1 < argc) baud = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-w") == 0 && i + 2 < argc) {
+            scriptText = argv[++i];
+            dotMs = atoi(argv[++i]);
+        }
+        else path = argv[i];
+    }
+    if ((path == NULL) == !pty || (scriptText != NULL && (!pty || dotMs <= 0)) || baudRate(baud) == 0) {
+        printf("Usage: %s [-v] [-b <baud>] <tty or file>\n"
+               "       %s [-v] -p [-w <text> <dot ms>]\n", argv[0], argv[0]);
+        return 1;
+    }
+
+    int fd;
+    pid_t writer = -1;
+    double start = 0;
+    static double gapTimes[MAX_LETTERS];
+    int scriptLetters = 0;
+
+    if (pty) {
+        fd = posix_openpt(O_RDWR | O_NOCTTY);
+        if (fd < 0 || grantpt(fd) != 0 || unlockpt(fd) != 0) {
+            perror("pseudo-terminal");
+            return 1;
+        }
+        fprintf(stderr, "Listening on %s\n", ptsname(fd));
+
+        // Raw slave so the bytes arrive as the tag wrote them. The writer gets the open slave,
+        // when it exits the master reads EIO and the listener ends
+        int slave = open(ptsname(fd), O_RDWR | O_NOCTTY);
+        struct termios tio;
+        if (slave < 0 || tcgetattr(slave, &tio) != 0) {
+            perror(ptsname(fd));
+            return 1;
+        }
+        cfmakeraw(&tio);
+        tcsetattr(slave, TCSANOW, &tio);
+
+        if (scriptText != NULL) {
+            scriptLetters = script(scriptText, dotMs, 0, -1, gapTimes, MAX_LETTERS);
+            if (scriptLetters > MAX_LETTERS) {
+                fprintf(stderr, "Script text has %d letters, at most %d are checked\n", scriptLetters, MAX_LETTERS);
+                return 1;
+            }
+            start = seconds() + 0.1;
+            writer = fork();
+            if (writer == 0) {
+                close(fd);
+                _exit(script(scriptText, dotMs, start, slave, gapTimes, MAX_LETTERS) < 0);
+            }
+            close(slave);
+        }
+    }
+    else {
+        fd = open(path, O_RDONLY | O_NOCTTY);
+        if (fd < 0) {
+            perror(path);
+            return 1;
+        }
+        struct termios tio;
+        if (isatty(fd) && tcgetattr(fd, &tio) == 0) {
+            cfmakeraw(&tio);
+            cfsetispeed(&tio, baudRate(baud));
+            cfsetospeed(&tio, baudRate(baud));
+            tio.c_cc[VMIN] = 1;
+            tio.c_cc[VTIME] = 0;
+            tcsetattr(fd, TCSANOW, &tio);
+        }
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onSignal;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    morse_decoder_t decoder;
+    morse_decoder_init(&decoder);
+    static double latency[MAX_LATENCIES], endToEnd[MAX_LATENCIES];
+    int letters = 0, mismatches = 0;
+    unsigned long symbols = 0, skipped = 0, words = 0, wordLetterCount = 0;
+    double first = 0;
+    char line[LINE_MAX_BYTES], decoded[MAX_LETTERS];
+    int lineLength = 0, decodedLength = 0;
+    char buffer[4096];
+
+    while (!stop) {
+        ssize_t n = read(fd, buffer, sizeof(buffer));
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) continue;
+            break;  // End of file, or EIO once the pty writer has gone
+        }
+        double received = seconds();
+        if (first == 0) first = received;
+
+        for (ssize_t i = 0; i < n; i++) {
+            char b = buffer[i];
+            if (b == '\0' || b == '\r') continue;  // The tag writes "%c\r\n" including the NUL
+            if (b != '\n') {
+                if (lineLength < LINE_MAX_BYTES - 1) line[lineLength++] = b;
+                continue;
+            }
+            if (wordLine(line, lineLength) && (words > 0 || !symbolLine(line, lineLength))) {
+                printf("%9.3f %.*s\n", received - first, lineLength, line);
+                fflush(stdout);
+                wordLetterCount += wordLetters(line, lineLength);
+                words++;
+                lineLength = 0;
+                continue;
+            }
+            if (!symbolLine(line, lineLength)) {
+                if (verbose && lineLength > 0) fprintf(stderr, "> %.*s\n", lineLength, line);
+                skipped += lineLength > 0;
+                lineLength = 0;
+                continue;
+            }
+
+            for (int j = 0; j < lineLength; j++) {
+                char c = morse_decoder_feed(&decoder, line[j]);
+                symbols++;
+                if (c == 0) continue;
+                if (c == ' ') {
+                    fputc(' ', stdout);
+                    fflush(stdout);
+                    continue;
+                }
+
+                char spelled[MORSE_SPELL_MAX];
+                fwrite(spelled, 1, morse_spell(c, spelled), stdout);
+                fflush(stdout);
+                double printed = seconds();
+                if (letters < MAX_LATENCIES) {
+                    latency[letters] = printed - received;
+                    if (letters < scriptLetters) endToEnd[letters] = printed - (start + gapTimes[letters]);
+                }
+                if (decodedLength < MAX_LETTERS) decoded[decodedLength++] = c;
+                letters++;
+            }
+            lineLength = 0;
+        }
+    }
+    if (symbols > 0) {
+        fputc('\n', stdout);
+        fflush(stdout);
+    }
+
+    if (writer > 0) {
+        int status;
+        waitpid(writer, &status, 0);
+
+        // The writer's text as the decoder should have produced it
+        morse_encoder_t encoder;
+        morse_event_t event;
+        char symbolsExpected[8];
+        morse_decoder_t check;
+        int expected = 0;
+        morse_decoder_init(&check);
+        morse_encoder_init(&encoder);
+        morse_encoder_input(&encoder, scriptText, strlen(scriptText));
+        for (;;) {
+            int k = morse_encode_symbols(&encoder, symbolsExpected, sizeof(symbolsExpected));
+            if (k == 0) {
+                if (!morse_encoder_end(&encoder, &event)) break;
+                symbolsExpected[k++] = ' ';
+            }
+            for (int j = 0; j < k; j++) {
+                char c = morse_decoder_feed(&check, symbolsExpected[j]);
+                if (c == 0 || c == ' ') continue;
+                if (expected >= decodedLength || decoded[expected] != c) mismatches++;
+                expected++;
+            }
+        }
+        mismatches += decodedLength > expected ? decodedLength - expected : expected - decodedLength;
+        fprintf(stderr, "Script: %d letters sent, %d decoded, %d wrong or missing\n",
+                scriptLetters, letters, mismatches);
+    }
+
+    // Word lines carry no letter gaps, only the symbol stream has latencies
+    int count = letters < MAX_LATENCIES ? letters : MAX_LATENCIES;
+    fprintf(stderr, "Symbols: %lu, letters: %d, words: %lu with %lu letters, other lines skipped: %lu\n",
+            symbols, letters, words, wordLetterCount, skipped);
+    if (symbols == 0 && words == 0) {
+        fprintf(stderr, "No symbol or word lines, is it the tag at %d baud?\n", baud);
+    }
+    if (count > 0) {
+        qsort(latency, count, sizeof(double), compareDouble);
+        double sum = 0;
+        for (int i = 0; i < count; i++) sum += latency[i];
+        fprintf(stderr, "Letter gap read to letter printed: min %.3f avg %.3f p95 %.3f max %.3f ms\n",
+                latency[0] * 1e3, sum / count * 1e3, latency[(count * 95 - 1) / 100] * 1e3,
+                latency[count - 1] * 1e3);
+    }
+    int scripted = count < scriptLetters ? count : scriptLetters;
+    if (scripted > 0) {
+        qsort(endToEnd, scripted, sizeof(double), compareDouble);
+        double sum = 0;
+        for (int i = 0; i < scripted; i++) sum += endToEnd[i];
+        fprintf(stderr, "Letter gap sent to letter printed:  min %.3f avg %.3f p95 %.3f max %.3f ms\n",
+                endToEnd[0] * 1e3, sum / scripted * 1e3, endToEnd[(scripted * 95 - 1) / 100] * 1e3,
+                endToEnd[scripted - 1] * 1e3);
+    }
+    close(fd);
+    return mismatches > 0 || (symbols == 0 && words == 0);
+}
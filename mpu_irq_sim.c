@@ -0,0 +1,170 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "motion/sample_timing.h"
+
+// Runs the sensor task's data-ready loop against a fake interrupt source. A thread fires
+// edges at the sample rate with jitter, drops some and pauses once for longer than the pend
+// timeout; each edge goes through sample_timing_edge() and posts a semaphore like mpuIntFxn.
+// The main thread pends with the firmware's 100 ms timeout, "reads" the sample and stamps it
+// the way project_main.c does. Timestamps tick at the CC26xx default 65536 Hz unless -f is
+// given. Checks the statistics against what the source did and exits non-zero on a mismatch.
+// Build: gcc -O2 -pthread -ICSProject mpu_irq_sim.c CSProject/motion/sample_timing.c -o mpu_irq_sim
+// Usage: mpu_irq_sim [-f <timestamp hz>] [-r <rate hz>] [-s <seconds>]
+
+#define TIMEOUT_MS   100   // Semaphore_pend timeout in the sensor task
+#define READ_US      300   // I2C read of one sample
+#define DROP_EVERY   97    // Every n-th edge is lost
+#define PAUSE_MS     150   // One gap longer than the timeout, halfway through
+
+static sample_timing_t timing;
+static sem_t dataReady;
+static uint32_t timestampHz = 65536;
+static int rate = 200, runSeconds = 3;
+static volatile int sourceDone = 0;
+static uint32_t edges = 0, dropped = 0, coalesced = 0;
+static uint32_t edgeMin = 0xFFFFFFFF, edgeMax = 0;
+static struct timespec epoch;
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Timestamp_get32() stand-in, starting at 1 so the first edge is never 0
+static uint32_t timestamp(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    double t = (ts.tv_sec - epoch.tv_sec) + (ts.tv_nsec - epoch.tv_nsec) / 1e9;
+    return 1 + (uint32_t)(t * timestampHz);
+}
+
+static void sleepUntil(double t) {
+    double now = seconds();
+    if (t > now) {
+        struct timespec ts = { (time_t)(t - now), (long)((t - now - (time_t)(t - now)) * 1e9) };
+        nanosleep(&ts, NULL);
+    }
+}
+
+// mpuIntFxn: stamp the edge and post the binary semaphore
+static void *source(void *arg) {
+    double period = 1.0 / rate, t = seconds();
+    int total = rate * runSeconds, paused = 0;
+    unsigned int seed = 1;
+
+    (void)arg;
+    for (int i = 1; i <= total; i++) {
+        seed = seed * 1103515245 + 12345;
+        double jitter = ((int)(seed >> 16) % 201 - 100) / 100.0 * period / 20;
+        t += period;
+        if (!paused && i > total / 2) {
+            t += PAUSE_MS / 1000.0;
+            paused = 1;
+        }
+        sleepUntil(t + jitter);
+        if (i % DROP_EVERY == 0) {
+            dropped++;
+            continue;
+        }
+        // Reference period statistics from the edges actually fired, the host scheduler
+        // adds its own jitter on top of the simulated one
+        uint32_t now = timestamp();
+        static uint32_t previous = 0;
+        if (previous != 0) {
+            if (now - previous < edgeMin) edgeMin = now - previous;
+            if (now - previous > edgeMax) edgeMax = now - previous;
+        }
+        previous = now;
+        sample_timing_edge(&timing, now);
+        edges++;
+
+        // A post to a binary semaphore that is already set is lost, as on the tag
+        int value;
+        sem_getvalue(&dataReady, &value);
+        if (value == 0) sem_post(&dataReady);
+        else coalesced++;
+    }
+    sourceDone = 1;
+    return NULL;
+}
+
+static int check(const char *what, int ok) {
+    printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i + 1 < argc; i += 2) {
+        if (strcmp(argv[i], "-f") == 0) timestampHz = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-r") == 0) rate = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0) runSeconds = atoi(argv[i + 1]);
+    }
+    if (timestampHz == 0 || rate <= 0 || rate > 1000 || runSeconds <= 0 || argc % 2 == 0) {
+        printf("Usage: %s [-f <timestamp hz>] [-r <rate hz>] [-s <seconds>]\n", argv[0]);
+        return 1;
+    }
+
+    int failed = 0;
+
+    // Conversions the firmware prints, at frequencies above and below 1 MHz
+    failed += check("us: 65536 Hz, 1 s", sample_timing_us(65536, 65536) == 1000000);
+    failed += check("us: 65536 Hz, 5 ms", sample_timing_us(328, 65536) == 5004);
+    failed += check("us: 32768 Hz, 1 tick", sample_timing_us(1, 32768) == 30);
+    failed += check("us: 48 MHz, 5 ms", sample_timing_us(240000, 48000000) == 5000);
+
+    clock_gettime(CLOCK_MONOTONIC, &epoch);
+    sample_timing_init(&timing);
+    sem_init(&dataReady, 0, 0);
+    pthread_t thread;
+    pthread_create(&thread, NULL, source, NULL);
+
+    // The sensor task loop
+    uint32_t lastStamp = 0, stampsBackwards = 0, staleTimeouts = 0;
+    while (!sourceDone) {
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += TIMEOUT_MS * 1000000L;
+        deadline.tv_sec += deadline.tv_nsec / 1000000000L;
+        deadline.tv_nsec %= 1000000000L;
+        int timedOut = sem_timedwait(&dataReady, &deadline) != 0;
+        if (timedOut && errno == EINTR) continue;
+
+        uint32_t stamp = timedOut ? timestamp() : timing.stamp;
+        struct timespec read = { 0, READ_US * 1000L };
+        nanosleep(&read, NULL);
+
+        if (lastStamp != 0 && (int32_t)(stamp - lastStamp) < 0) stampsBackwards++;
+        if (timedOut && stamp == lastStamp) staleTimeouts++;
+        lastStamp = stamp;
+        if (timedOut) sample_timing_timeout(&timing);
+        else sample_timing_sample(&timing, stamp, timestamp());
+    }
+    pthread_join(thread, NULL);
+
+    uint32_t read = timing.samples - timing.timeouts;
+    double periodUs = 1e6 / rate;
+    uint32_t periodMin = sample_timing_us(timing.periodMin, timestampHz);
+    uint32_t periodMax = sample_timing_us(timing.periodMax, timestampHz);
+    uint32_t latencyAvg = read > 0 ? sample_timing_us(timing.latencySum / read, timestampHz) : 0;
+    uint32_t latencyMax = sample_timing_us(timing.latencyMax, timestampHz);
+
+    printf("%u edges, %u dropped, %u coalesced, %u samples, %u timeouts, period %u-%u us, latency avg %u us max %u us\n",
+           edges, dropped, coalesced, timing.samples, timing.timeouts, periodMin, periodMax, latencyAvg, latencyMax);
+
+    failed += check("every posted edge read once", read == edges - coalesced);
+    failed += check("pause longer than the timeout seen", timing.timeouts >= 1);
+    failed += check("timeout samples stamped when read", staleTimeouts == 0 && stampsBackwards == 0);
+    failed += check("period min/max match the edges", timing.periodMin == edgeMin && timing.periodMax == edgeMax);
+    failed += check("period min at most one period", periodMin <= periodUs);
+    failed += check("period max covers the pause", periodMax > TIMEOUT_MS * 1000);
+    failed += check("latency at least the read time", latencyAvg + 1e6 / timestampHz >= READ_US);
+    return failed > 0;
+}
@@ -1,6 +1,5 @@
 /* C Standard library */
 #include <stdio.h>
-#include <math.h>
 
 /* XDCtools files */
 #include <xdc/std.h>
@@ -23,8 +22,7 @@
 #include "Board.h"
 #include "sensors/opt3001.h"
 #include "sensors/mpu9250.h"
-
-#define PI 3.14159265
+#include "motion/fixmath.h"
 
 /* Task */
 #define STACKSIZE 2048
@@ -208,8 +206,11 @@ Void mpuSensorTaskFxn(UArg arg0, UArg arg1) {
         if (MPUState == WAITING) {
 
             mpu9250_get_data(&i2cMPU, &ax, &ay, &az, &gx, &gy, &gz);
-            roll = atan2(ay, az) * 180.0 / PI;
-            pitch = atan2(-ax, sqrt(ay * ay + az * az)) * 180.0 / PI;
+
+            // Tilt in integer math (mg in, mdeg out), the M3 has no FPU for libm atan2/sqrt
+            int32_t mx = (int32_t)(ax * 1000), my = (int32_t)(ay * 1000), mz = (int32_t)(az * 1000);
+            roll = fix_atan2(my, mz) / 1000.0f;
+            pitch = fix_atan2(-mx, fix_sqrt((uint32_t)(my * my) + (uint32_t)(mz * mz))) / 1000.0f;
             MPUState = DATA_READY;
 
         }
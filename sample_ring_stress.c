@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "motion/sample_ring.h"
+
+// Hammers the sample ring (CSProject/motion/sample_ring.c) from threads: one producer pushes
+// sequence-numbered samples in bursts of half a ring, like a FIFO drain of the sensor task
+// without the milliseconds between bursts, while readers copy them out concurrently. Every
+// field of a sample is derived from its sequence number, so a copy torn by the producer lapping
+// the slot shows up as a mismatch. The "next" readers must see every sample in order or count
+// the ones they missed as overflows, one of them naps to fall behind on purpose; the "latest"
+// reader must only ever move forward. Exits non-zero when a check fails. A torn copy needs the
+// producer to run while a reader is mid-copy, so run it on several cores, and on an ARM host
+// as well to exercise SAMPLE_RING_BARRIER(); on x86 the hardware keeps the stores in order.
+// Build: gcc -O2 -pthread -ICSProject sample_ring_stress.c CSProject/motion/sample_ring.c -o sample_ring_stress
+// Usage: sample_ring_stress [-n <samples>] [-r <next readers>] [-f]
+
+#define MAX_READERS  8
+#define BURST        (SAMPLE_RING_SIZE / 2)
+#define BURST_US     10     // Pause after a burst, -f leaves it out
+#define SLOW_EVERY   1000   // The slow reader naps after this many samples
+#define SLOW_NAP_US  200
+
+typedef struct {
+    int slow, latest;
+    uint32_t received, torn, backwards;
+    uint32_t overflows, missed;
+    uint32_t last;
+    pthread_t thread;
+} reader_t;
+
+static sample_ring_t ring;
+static volatile int producerDone = 0;
+static uint32_t total = 1000000;
+static int burstUs = BURST_US;
+static pthread_barrier_t startLine;
+
+static double seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// Sample n, starting at 1 so a reader's last = 0 means nothing read yet
+static void fill(imu_sample_t *s, uint32_t n) {
+    s->time = n;
+    for (int i = 0; i < 3; i++) {
+        s->accel[i] = (int16_t)(n * (i + 3));
+        s->gyro[i] = (int16_t)~(n + i);
+    }
+}
+
+static int intact(const imu_sample_t *s) {
+    imu_sample_t expected;
+    fill(&expected, s->time);
+    return memcmp(s, &expected, sizeof(*s)) == 0;
+}
+
+static void *producer(void *arg) {
+    imu_sample_t s;
+
+    (void)arg;
+    pthread_barrier_wait(&startLine);
+    for (uint32_t n = 1; n <= total; n++) {
+        fill(&s, n);
+        sample_ring_push(&ring, &s);
+        if (n % BURST == 0 && burstUs > 0) {
+            // Sleep rather than spin, so the readers also run on a single core
+            struct timespec pause = { 0, burstUs * 1000L };
+            nanosleep(&pause, NULL);
+        }
+    }
+    __sync_synchronize();
+    producerDone = 1;
+    return NULL;
+}
+
+static void take(reader_t *rd, const imu_sample_t *s) {
+    if (!intact(s)) {
+        rd->torn++;
+        return;
+    }
+    if (rd->last != 0 && s->time <= rd->last) rd->backwards++;
+    if (s->time > rd->last + 1) rd->missed += s->time - rd->last - 1;
+    rd->last = s->time;
+    rd->received++;
+}
+
+static void *reader(void *arg) {
+    reader_t *rd = arg;
+    sample_reader_t cursor;
+    imu_sample_t s;
+
+    // Readers start before the first push, so every sample is theirs to read or lose
+    sample_reader_init(&cursor, &ring);
+    pthread_barrier_wait(&startLine);
+    for (;;) {
+        // Done is read before the ring, so an empty ring after it means the last push was seen
+        int done = producerDone;
+        __sync_synchronize();
+        int got = rd->latest ? sample_reader_latest(&cursor, &s) : sample_reader_next(&cursor, &s);
+        if (got) {
+            take(rd, &s);
+            if (rd->slow && rd->received % SLOW_EVERY == 0) {
+                struct timespec nap = { 0, SLOW_NAP_US * 1000L };
+                nanosleep(&nap, NULL);
+            }
+        }
+        else if (done) {
+            break;
+        }
+    }
+    rd->overflows = cursor.overflows;
+    return NULL;
+}
+
+static int check(const char *what, int ok) {
+    printf("%-44s %s\n", what, ok ? "ok" : "FAILED");
+    return ok ? 0 : 1;
+}
+
+int main(int argc, char *argv[]) {
+    int readers = 2;
+
+    int usage = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-f") == 0) burstUs = 0;
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) total = strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-r") == 0 && i + 1 < argc) readers = atoi(argv[++i]);
+        else usage = 1;
+    }
+    if (usage || total == 0 || total > 0x7FFFFFFF || readers < 1 || readers > MAX_READERS - 1) {
+        printf("Usage: %s [-n <samples>] [-r <next readers, 1-%d>] [-f]\n", argv[0], MAX_READERS - 1);
+        return 1;
+    }
+
+    // The first next reader keeps up, the second naps, the last one only takes the newest
+    static reader_t rd[MAX_READERS];
+    int count = readers + 1;
+    for (int i = 0; i < count; i++) {
+        rd[i].slow = i == 1;
+        rd[i].latest = i == readers;
+    }
+
+    sample_ring_init(&ring);
+    pthread_barrier_init(&startLine, NULL, count + 1);
+    pthread_t thread;
+    double start = seconds();
+    for (int i = 0; i < count; i++) pthread_create(&rd[i].thread, NULL, reader, &rd[i]);
+    pthread_create(&thread, NULL, producer, NULL);
+    pthread_join(thread, NULL);
+    for (int i = 0; i < count; i++) pthread_join(rd[i].thread, NULL);
+    double elapsed = seconds() - start;
+
+    printf("%u samples in %.2f s, %.1f M/s\n", total, elapsed, total / elapsed / 1e6);
+    int failed = 0;
+    for (int i = 0; i < count; i++) {
+        char what[64];
+        const char *kind = rd[i].latest ? "latest" : rd[i].slow ? "next, slow" : "next";
+        printf("reader %d (%s): %u received, %u overflows, %u torn, %u backwards\n",
+               i, kind, rd[i].received, rd[i].overflows, rd[i].torn, rd[i].backwards);
+
+        snprintf(what, sizeof(what), "reader %d: no torn samples", i);
+        failed += check(what, rd[i].torn == 0);
+        snprintf(what, sizeof(what), "reader %d: strictly in order", i);
+        failed += check(what, rd[i].backwards == 0);
+        snprintf(what, sizeof(what), "reader %d: ends on the last sample", i);
+        failed += check(what, rd[i].last == total);
+        if (rd[i].latest) {
+            snprintf(what, sizeof(what), "reader %d: skips are not overflows", i);
+            failed += check(what, rd[i].overflows == 0);
+        }
+        else {
+            snprintf(what, sizeof(what), "reader %d: every gap counted as overflow", i);
+            failed += check(what, rd[i].missed == rd[i].overflows);
+            snprintf(what, sizeof(what), "reader %d: received + overflows = pushed", i);
+            failed += check(what, rd[i].received + rd[i].overflows == total);
+        }
+    }
+    if (readers >= 2) {
+        failed += check("slow reader fell behind", rd[1].overflows > 0);
+    }
+    return failed > 0;
+}